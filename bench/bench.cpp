@@ -0,0 +1,269 @@
+namespace command_line {
+    const char help_message[] =
+" [options]\n"
+"Times the hot paths of the pattern recognition modules\n"
+"on synthetic datasets, and writes the results to stdout.\n"
+"Each line of the output has the benchmark name,\n"
+"the number of entries (n), attributes (d) and neighbors (k) of the input\n"
+"(zero if not applicable), the number of timed iterations,\n"
+"and the time per iteration, in seconds.\n"
+"\n"
+"Options:\n"
+"--size <N>\n"
+"    Number of entries of the largest datasets.\n"
+"    The quadratic algorithms (IBL and dendograms) use N/4 entries.\n"
+"    Default: 2000.\n"
+"\n"
+"--min-time <F>\n"
+"    Minimum time, in seconds, spent timing each benchmark.\n"
+"    Default: 0.2.\n"
+"\n"
+"--filter <text>\n"
+"    Run only the benchmarks whose name contains <text>.\n"
+"    Can be given several times.\n"
+"\n"
+"--json\n"
+"    Write the results as a JSON array instead of CSV.\n"
+"\n"
+"--output <file>\n"
+"    Write the results to <file> instead of stdout.\n"
+"\n"
+"--seed <N>\n"
+"    Seed used to generate the datasets.\n"
+"    Default: 1.\n"
+"\n"
+"--threads <N>\n"
+"    Number of threads of the parallel algorithms.\n"
+"    Default: number of hardware threads.\n"
+"\n"
+"--help\n"
+"    Display this help and exit.\n"
+;
+} // namespace command_line
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "bench/benchmark.hpp"
+#include "cmdline/args.hpp"
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+#include "pr/dendogram.h"
+#include "pr/ibl.h"
+#include "pr/mahalanobis.h"
+#include "pr/nearest_neighbor.h"
+#include "pr/p_norm.h"
+#include "pr/synthetic.h"
+#include "util/cv.h"
+#include "util/parallel.hpp"
+
+namespace command_line {
+    std::size_t size = 2000;
+    double min_time = 0.2;
+    std::vector< std::string > filters;
+    bool json = false;
+    std::string output;
+    long long unsigned seed = 1;
+
+    void parse( cmdline::args&& args ) {
+        while( args.size() > 0 ) {
+            std::string arg = args.next();
+            if( arg == "--size" ) {
+                args.range( 8 ) >> size;
+                continue;
+            }
+            if( arg == "--min-time" ) {
+                args.range( 0 ) >> min_time;
+                continue;
+            }
+            if( arg == "--filter" ) {
+                filters.push_back( args.next() );
+                continue;
+            }
+            if( arg == "--json" ) {
+                json = true;
+                continue;
+            }
+            if( arg == "--output" ) {
+                output = args.next();
+                continue;
+            }
+            if( arg == "--seed" ) {
+                args >> seed;
+                continue;
+            }
+            if( arg == "--threads" ) {
+                args.range( 1 ) >> util::thread_count();
+                continue;
+            }
+            if( arg == "--help" ) {
+                std::cout << args.program_name() << help_message;
+                std::exit(0);
+            }
+            std::cerr << args.program_name() << ": Unknown option " << arg << '\n';
+            std::exit(1);
+        }
+    }
+} // namespace command_line
+
+/* Dataset of n entries with d attributes, drawn from one gaussian blob
+ * per category; see pr/synthetic.h.
+ */
+DataSet synthetic( std::size_t n, std::size_t d, unsigned categories ) {
+    return SyntheticDataset( SyntheticDataset::gaussian, d, categories, 0,
+        command_line::seed + 1000003 * n + d ).dataset( n );
+}
+
+bool selected( const std::string & name ) {
+    if( command_line::filters.empty() )
+        return true;
+    for( const std::string & filter : command_line::filters )
+        if( name.find( filter ) != std::string::npos )
+            return true;
+    return false;
+}
+
+// Keeps the compiler from discarding the benchmarked computations.
+volatile double sink;
+
+int main( int argc, char ** argv ) {
+    command_line::parse( cmdline::args(argc, argv) );
+    const std::size_t large = command_line::size;
+    const std::size_t small = large / 4;
+    const double min_time = command_line::min_time;
+    std::vector< bench::result > results;
+
+    auto run = [&]( const std::string & name, std::size_t n, std::size_t d, std::size_t k, auto f ) {
+        if( !selected( name ) )
+            return;
+        results.push_back( bench::measure( name, n, d, k, min_time, f ) );
+        std::fprintf( stderr, "%s n=%zu d=%zu k=%zu: %g s\n",
+            name.c_str(), n, d, k, results.back().seconds );
+    };
+
+    if( selected( "parse" ) ) {
+        DataSet dataset = synthetic( large, 4, 3 );
+        char * text;
+        std::size_t length;
+        std::FILE * file = open_memstream( &text, &length );
+        dataset.write( file );
+        std::fclose( file );
+        run( "parse", large, 4, 0, [&]() {
+            std::FILE * input = fmemopen( text, length, "r" );
+            sink = DataSet::parse( input ).size();
+            std::fclose( input );
+        });
+        std::free( text );
+    }
+
+    // Each iteration measures the distance from one entry to all of them.
+    for( std::size_t d : {3, 8} ) {
+        DataSet dataset = synthetic( large, d, 3 );
+        const DataEntry & query = *dataset.begin();
+        auto distance_run = [&]( const std::string & name, DistanceCalculator & distance ) {
+            distance.calibrate( dataset );
+            run( name, large, d, 0, [&]() {
+                double sum = 0;
+                for( const DataEntry & entry : dataset )
+                    sum += distance( query, entry );
+                sink = sum;
+            });
+        };
+        EuclideanDistance euclidean( 0.1 );
+        distance_run( "distance/euclidean", euclidean );
+        ManhattanDistance manhattan( 0.1 );
+        distance_run( "distance/manhattan", manhattan );
+        if( selected( "distance/mahalanobis" ) ) {
+            MahalanobisDistance mahalanobis;
+            distance_run( "distance/mahalanobis", mahalanobis );
+        }
+    }
+
+    // Each iteration classifies one query, cycling through a list.
+    for( std::size_t n : {small, large} )
+        for( std::size_t d : {2, 8} )
+            for( std::size_t k : {1, 5} ) {
+                if( !selected( "classify" ) )
+                    continue;
+                NearestNeighbor nn(
+                    std::make_unique< DataSet >( synthetic( n, d, 3 ) ),
+                    std::make_unique< EuclideanDistance >( 0.1 ),
+                    k
+                );
+                DataSet queries = synthetic( 64, d, 3 );
+                std::size_t next = 0;
+                run( "classify", n, d, k, [&]() {
+                    sink = nn.classify( queries.begin()[next++ % queries.size()] ).size();
+                });
+            }
+
+    {
+        DataSet dataset = synthetic( small, 4, 3 );
+        auto train = [&]( const std::string & name, auto make ) {
+            run( name, small, 4, 0, [&]() {
+                auto ibl = make();
+                ibl->train( dataset );
+                sink = ibl->conceptual_descriptor().size();
+            });
+        };
+        train( "ibl1", []() { return std::make_unique< ibl1 >(); } );
+        train( "ibl2", []() { return std::make_unique< ibl2 >(); } );
+        train( "ibl3", []() {
+            auto ibl = std::make_unique< ibl3 >();
+            ibl->seed( 1 );
+            return ibl;
+        });
+        train( "ibl4", []() {
+            auto ibl = std::make_unique< ibl4 >();
+            ibl->seed( 1 );
+            return ibl;
+        });
+    }
+
+    {
+        DataSet dataset = synthetic( small, 4, 3 );
+        for( const char * linkage : {"simple", "full", "mean", "ward", "centroid", "median", "weighted"} ) {
+            const LinkageMethod * method = find_linkage_method( linkage );
+            run( std::string("dendogram/") + linkage, small, 4, 0, [&]() {
+                sink = generate_dendogram( dataset, *method->distance, *method->update )
+                    .root().linkage_distance();
+            });
+        }
+    }
+
+    for( std::size_t k : {1, 3} )
+        for( bool brute_force : {false, true} ) {
+            std::string name = brute_force ? "influence_areas/brute_force" : "influence_areas";
+            if( !selected( name ) )
+                continue;
+            NearestNeighbor nn(
+                std::make_unique< DataSet >( synthetic( small, 2, 3 ) ),
+                std::make_unique< EuclideanDistance >( 0.1 ),
+                k
+            );
+            cv::Mat img( 200, 200, CV_8UC3 );
+            run( name, small, 2, k, [&]() {
+                util::influence_areas( img, nn, 0.05, brute_force );
+            });
+        }
+
+    std::FILE * output = stdout;
+    if( command_line::output != "" ) {
+        output = std::fopen( command_line::output.c_str(), "w" );
+        if( output == nullptr ) {
+            std::cerr << "Could not open " << command_line::output << '\n';
+            return 1;
+        }
+    }
+    if( command_line::json )
+        bench::write_json( output, results );
+    else
+        bench::write_csv( output, results );
+    if( output != stdout )
+        std::fclose( output );
+    return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef BENCH_BENCHMARK_HPP
+#define BENCH_BENCHMARK_HPP
+
+/* Minimal timing harness for the benchmarks.
+ *
+ * Each benchmark is a function called repeatedly;
+ * the number of calls doubles until the calls take at least
+ * a minimum time, and the time per call of the last round is reported.
+ * A first call, not timed, warms up caches and lazy initializations.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+    /* Result of a benchmark.
+     * n, d and k are the number of entries, attributes and neighbors
+     * of the input; unused parameters are zero.
+     */
+    struct result {
+        std::string name;
+        std::size_t n;
+        std::size_t d;
+        std::size_t k;
+        std::size_t iterations;
+        double seconds; // per iteration
+    };
+
+    template< typename Function >
+    result measure(
+        const std::string & name,
+        std::size_t n,
+        std::size_t d,
+        std::size_t k,
+        double min_time,
+        Function f
+    ) {
+        using clock = std::chrono::steady_clock;
+        f();
+
+        std::size_t iterations = 1;
+        while( true ) {
+            auto start = clock::now();
+            for( std::size_t i = 0; i < iterations; i++ )
+                f();
+            std::chrono::duration< double > elapsed = clock::now() - start;
+            if( elapsed.count() >= min_time || iterations >= (std::size_t(1) << 30) )
+                return { name, n, d, k, iterations, elapsed.count() / iterations };
+            iterations *= 2;
+        }
+    }
+
+    inline void write_csv( std::FILE * file, const std::vector< result > & results ) {
+        std::fprintf( file, "benchmark,n,d,k,iterations,seconds\n" );
+        for( const result & r : results )
+            std::fprintf( file, "%s,%zu,%zu,%zu,%zu,%.9g\n",
+                r.name.c_str(), r.n, r.d, r.k, r.iterations, r.seconds );
+    }
+
+    // The benchmark names have no characters that need escaping.
+    inline void write_json( std::FILE * file, const std::vector< result > & results ) {
+        std::fprintf( file, "[\n" );
+        for( std::size_t i = 0; i < results.size(); i++ ) {
+            const result & r = results[i];
+            std::fprintf( file,
+                "  {\"benchmark\": \"%s\", \"n\": %zu, \"d\": %zu, \"k\": %zu, "
+                "\"iterations\": %zu, \"seconds\": %.9g}%s\n",
+                r.name.c_str(), r.n, r.d, r.k, r.iterations, r.seconds,
+                i + 1 < results.size() ? "," : "" );
+        }
+        std::fprintf( file, "]\n" );
+    }
+
+} // namespace bench
+
+#endif // BENCH_BENCHMARK_HPP
@@ -0,0 +1,31 @@
+BENCHDIR := $(dir $(lastword $(MAKEFILE_LIST)))
+
+BENCH := $(BENCHDIR)bench
+BENCHSRC := $(shell find $(BENCHDIR) -name "*.cpp")
+
+prog += $(BENCH)
+src += $(BENCHSRC)
+dep += $(BENCHSRC:.cpp=.dep.mk)
+
+$(BENCH): $(BENCHSRC:.cpp=.o)
+
+all : $(BENCH)
+
+# Extra options for the benchmark program; for instance,
+#   make bench BENCHFLAGS="--json --output results.json"
+BENCHFLAGS ?=
+
+.PHONY: bench
+bench: $(BENCH)
+	$(BENCH) $(BENCHFLAGS)
+
+
+.PHONY: bench-clean bench-mostlyclean
+
+mostlyclean: bench-mostlyclean
+bench-mostlyclean:
+	find $(BENCHDIR) -name "*.o" -exec rm {} +
+
+clean: bench-clean
+bench-clean: bench-mostlyclean
+	rm -f $(BENCH)
@@ -4,12 +4,16 @@
  */
 #include "pr/classifier.h"
 #include "pr/data_set.h"
+#include "util/stats.h"
+
+util::stats::phase classify_phase( "classify.queries" );
 
 int main( int argc, char ** argv ) {
     auto ptr = generate_classifier(cmdline::args(argc, argv));
     NearestNeighbor & classifier = *ptr;
     std::size_t attribute_count = classifier.dataset().attribute_count();
     DataEntry entry;
+    util::stats::timer timer( classify_phase );
     while( true ) {
         entry = DataEntry::parse(stdin, attribute_count );
         if( entry.attribute_count() != attribute_count )
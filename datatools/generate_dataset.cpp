@@ -0,0 +1,251 @@
+namespace command_line {
+    const char help_message[] =
+"%s [options]\n"
+"Generates a synthetic dataset of any size, for load tests.\n"
+"The entries are generated and formatted in parallel, in blocks,\n"
+"and streamed to the output, so the dataset is never kept in memory.\n"
+"The output depends only on the seed and on the options below,\n"
+"not on the number of threads.\n"
+"The dataset is printed to stdout.\n"
+"\n"
+"Options:\n"
+"\n"
+"-e <N>, --entries <N>\n"
+"    Number of entries.\n"
+"    Default value: 1000.\n"
+"\n"
+"-a <N>, --attributes <N>\n"
+"    Number of attributes, named x0, x1, and so on.\n"
+"    Default value: 2.\n"
+"\n"
+"-c <N>, --classes <N>\n"
+"    Number of classes, named c0, c1, and so on.\n"
+"    The category is named \"class\".\n"
+"    Default value: 2.\n"
+"\n"
+"--shape <name>\n"
+"    Shape of the classes. The options are:\n"
+"    gaussian: one gaussian blob per class, with unit variance,\n"
+"        centered at a random point of [0, 10]^d.\n"
+"    uniform: entries uniform over [0, 10]^d;\n"
+"        the class is that of the nearest of one random center per class.\n"
+"    spiral: one spiral per class in the first two attributes;\n"
+"        the other attributes are gaussian noise.\n"
+"    Default value: gaussian.\n"
+"\n"
+"--label-noise <F>\n"
+"    Probability that the class of an entry is replaced\n"
+"    by a random class.\n"
+"    Default value: 0.\n"
+"\n"
+"--seed <N>\n"
+"    Use N as the seed.\n"
+"    If not set, gererate a seed according to the current time.\n"
+"    In text output, the seed is inserted in the dataset, as a commentary.\n"
+"\n"
+"--binary\n"
+"    Write the dataset in the binary format of pr/binary_dataset.h.\n"
+"\n"
+"--output <file>\n"
+"    Write the dataset to <file> instead of stdout.\n"
+"\n"
+"--threads <N>\n"
+"    Number of threads used to generate the entries.\n"
+"    Default value: number of hardware threads.\n"
+"\n"
+"--help\n"
+"    Display this help and quit.\n"
+;
+} // namespace command_line
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cmdline/args.hpp"
+#include "pr/binary_dataset.h"
+#include "pr/synthetic.h"
+#include "util/parallel.hpp"
+
+namespace command_line {
+    std::uint64_t entries = 1000;
+    std::size_t attributes = 2;
+    unsigned classes = 2;
+    SyntheticDataset::shape_type shape = SyntheticDataset::gaussian;
+    double label_noise = 0;
+    bool binary = false;
+    std::string output;
+
+    std::uint64_t seed =
+        std::chrono::system_clock::now().time_since_epoch().count();
+
+    void parse( cmdline::args && args ) {
+        while( args.size() > 0 ) {
+            std::string arg = args.next();
+            if( arg == "-e" || arg == "--entries" ) {
+                args >> entries;
+                continue;
+            }
+            if( arg == "-a" || arg == "--attributes" ) {
+                args.range( 1 ) >> attributes;
+                continue;
+            }
+            if( arg == "-c" || arg == "--classes" ) {
+                args.range( 1 ) >> classes;
+                continue;
+            }
+            if( arg == "--shape" ) {
+                std::string name = args.next();
+                if( name == "gaussian" )
+                    shape = SyntheticDataset::gaussian;
+                else if( name == "uniform" )
+                    shape = SyntheticDataset::uniform;
+                else if( name == "spiral" )
+                    shape = SyntheticDataset::spiral;
+                else {
+                    std::fprintf( stderr, "Unknown shape %s.\n", name.c_str() );
+                    std::exit(1);
+                }
+                continue;
+            }
+            if( arg == "--label-noise" ) {
+                args.range( 0, 1 ) >> label_noise;
+                continue;
+            }
+            if( arg == "--seed" ) {
+                args >> seed;
+                continue;
+            }
+            if( arg == "--binary" ) {
+                binary = true;
+                continue;
+            }
+            if( arg == "--output" ) {
+                output = args.next();
+                continue;
+            }
+            if( arg == "--threads" ) {
+                args.range( 1 ) >> util::thread_count();
+                continue;
+            }
+            if( arg == "--help" ) {
+                std::printf( help_message, args.program_name().c_str() );
+                std::exit(0);
+            }
+            std::fprintf( stderr, "Unknown parameter %s.\n", arg.c_str() );
+            std::exit(1);
+        }
+    }
+} // namespace command_line
+
+// Number of entries generated and formatted at once by each thread.
+const std::size_t block_size = 16384;
+
+/* Appends the entries [begin, end) to the buffer,
+ * formatted as DataEntry::write or as described in pr/binary_dataset.h.
+ */
+void format_block(
+    const SyntheticDataset & generator,
+    std::uint64_t begin,
+    std::uint64_t end,
+    std::string & buffer
+) {
+    std::size_t d = generator.attribute_count();
+    std::vector< double > values( d );
+    char number[64];
+    for( std::uint64_t i = begin; i < end; i++ ) {
+        std::uint32_t c = generator.generate( i, values.data() );
+        if( command_line::binary ) {
+            buffer.append( (const char *) values.data(), d * sizeof(double) );
+            buffer.append( (const char *) &c, sizeof(c) );
+            continue;
+        }
+        for( double value : values ) {
+            buffer.append( number, std::snprintf( number, sizeof(number), "%lf,", value ) );
+        }
+        buffer += SyntheticDataset::class_name( c );
+        buffer += '\n';
+    }
+}
+
+int main( int argc, char ** argv ) {
+    command_line::parse( cmdline::args(argc, argv) );
+    std::unique_ptr< SyntheticDataset > generator;
+    try {
+        generator = std::make_unique< SyntheticDataset >(
+            command_line::shape,
+            command_line::attributes,
+            command_line::classes,
+            command_line::label_noise,
+            command_line::seed
+        );
+    }
+    catch( const char * message ) {
+        std::fprintf( stderr, "%s\n", message );
+        return 2;
+    }
+
+    std::FILE * output = stdout;
+    if( command_line::output != "" ) {
+        output = std::fopen( command_line::output.c_str(), command_line::binary ? "wb" : "w" );
+        if( output == nullptr ) {
+            std::fprintf( stderr, "Could not open %s.\n", command_line::output.c_str() );
+            return 3;
+        }
+    }
+
+    if( command_line::binary ) {
+        BinaryDatasetHeader header;
+        for( std::size_t a = 0; a < command_line::attributes; a++ )
+            header.attribute_names.push_back( "x" + std::to_string(a) );
+        header.category_name = "class";
+        for( unsigned c = 0; c < command_line::classes; c++ )
+            header.category_values.push_back( SyntheticDataset::class_name( c ) );
+        header.entry_count = command_line::entries;
+        try {
+            write_binary_header( output, header );
+        }
+        catch( const char * message ) {
+            std::fprintf( stderr, "%s\n", message );
+            return 3;
+        }
+    }
+    else {
+        std::fprintf( output, "# seed %llu\n", (unsigned long long) command_line::seed );
+        std::fprintf( output, "n %zu\n", command_line::attributes + 1 );
+        for( std::size_t a = 0; a < command_line::attributes; a++ )
+            std::fprintf( output, "a x%zu\n", a );
+        std::fprintf( output, "c class\n\n" );
+    }
+
+    /* Each round formats a batch of blocks concurrently, one buffer per block,
+     * and then writes the buffers in order.
+     */
+    std::uint64_t blocks = (command_line::entries + block_size - 1) / block_size;
+    std::size_t batch = 4 * util::thread_count();
+    std::vector< std::string > buffers( batch );
+    for( std::uint64_t first = 0; first < blocks; first += batch ) {
+        std::size_t count = std::min< std::uint64_t >( batch, blocks - first );
+        util::parallel_for( 0, count, [&]( std::size_t k ) {
+            std::uint64_t begin = (first + k) * block_size;
+            std::uint64_t end = std::min< std::uint64_t >( begin + block_size, command_line::entries );
+            buffers[k].clear();
+            format_block( *generator, begin, end, buffers[k] );
+        });
+        for( std::size_t k = 0; k < count; k++ )
+            if( std::fwrite( buffers[k].data(), 1, buffers[k].size(), output ) != buffers[k].size() ) {
+                std::fprintf( stderr, "Error writing the dataset.\n" );
+                return 3;
+            }
+    }
+
+    if( output != stdout && std::fclose( output ) != 0 ) {
+        std::fprintf( stderr, "Error writing the dataset.\n" );
+        return 3;
+    }
+    return 0;
+}
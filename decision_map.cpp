@@ -0,0 +1,171 @@
+namespace command_line {
+    const char help_message[] =
+" [options]\n"
+"Classifies every point of a regular grid over the attributes of the dataset,\n"
+"and writes the chosen categories to a binary file (a decision map).\n"
+"The file format is described in pr/decision_map.h.\n"
+"Input is read on stdin.\n"
+"\n"
+"Options:\n"
+"--output <file>\n"
+"    Write the decision map to <file>.\n"
+"    Default: decision_map.bin\n"
+"\n"
+"--density <N>\n"
+"    Divide each axis of the grid in N intervals;\n"
+"    that is, use N+1 points per axis.\n"
+"    Default: 100.\n"
+"\n"
+"--expand <F>\n"
+"    Percentage of the dataset extension that should be used as border.\n"
+"    Default value: 0.05.\n"
+"\n"
+"--fix <attribute> <value>\n"
+"    Hold the attribute (counted from zero) at the given value,\n"
+"    instead of making it an axis of the grid.\n"
+"    Can be given several times; for instance, fixing all but two\n"
+"    of the attributes gives a 2-D slice of the classifier.\n"
+"\n"
+"--raw\n"
+"    Write one label per point, instead of run-length encoding them.\n"
+"\n"
+"--threads <N>\n"
+"    Number of threads used to classify the grid.\n"
+"    Default: number of hardware threads.\n"
+"\n"
+"--help\n"
+"    Display this help and exit.\n"
+"\n"
+"Classifier options:\n"
+"These options are passed directly to the classifier.\n"
+"Run .classify --help for more information.\n"
+"--manhattan\n"
+"--hamming\n"
+"--euclidean\n"
+"--neighbors <N>\n"
+"--normalize\n"
+"--no-normalize\n"
+"--normalize-tolerance <F>\n"
+"--stats\n"
+;
+} // namespace command_line
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include "cmdline/args.hpp"
+#include "pr/classifier.h"
+#include "pr/decision_map.h"
+#include "util/parallel.hpp"
+#include "util/stats.h"
+
+namespace command_line {
+    std::string output_file_name = "decision_map.bin";
+    unsigned density = 100;
+    double expand = 0.05;
+    std::vector< DecisionMap::fixed_attribute > fixed;
+    bool raw = false;
+
+    /* Arguments that will be passed to the classifier. */
+    cmdline::args subargs;
+
+    void parse( cmdline::args&& args ) {
+        subargs.program_name(args.program_name());
+        while( args.size() > 0 ) {
+            std::string arg = args.next();
+            if( arg == "--output" ) {
+                output_file_name = args.next();
+                continue;
+            }
+            if( arg == "--density" ) {
+                args >> density;
+                continue;
+            }
+            if( arg == "--expand" ) {
+                args >> expand;
+                continue;
+            }
+            if( arg == "--fix" ) {
+                DecisionMap::fixed_attribute f;
+                args >> f.attribute;
+                args >> f.value;
+                fixed.push_back( f );
+                continue;
+            }
+            if( arg == "--raw" ) {
+                raw = true;
+                continue;
+            }
+            if( arg == "--threads" ) {
+                args.range( 1 ) >> util::thread_count();
+                continue;
+            }
+            if( arg == "--manhattan"
+             || arg == "--hamming"
+             || arg == "--euclidean"
+             || arg == "--normalize"
+             || arg == "--no-normalize"
+             || arg == "--stats" ) {
+                subargs.push_back( arg );
+                continue;
+            }
+            if( arg == "--neighbors" || arg == "--normalize-tolerance" ) {
+                subargs.push_back( arg );
+                subargs.push_back( args.next() );
+                continue;
+            }
+            if( arg == "--help" ) {
+                std::cout << args.program_name() << help_message;
+                std::exit(0);
+            }
+            std::cerr << args.program_name() << ": Unknown option " << arg << '\n';
+            std::exit(1);
+        }
+    }
+} // namespace command_line
+
+util::stats::phase evaluate_phase( "decision_map.evaluate" );
+util::stats::phase write_phase( "decision_map.write" );
+
+int main( int argc, char ** argv ) {
+    command_line::parse( cmdline::args(argc,argv) );
+
+    auto ptr = generate_classifier( std::move(command_line::subargs) );
+    NearestNeighbor & classifier = *ptr;
+
+    DecisionMap map;
+    util::stats::timer evaluate_timer( evaluate_phase );
+    try {
+        map = evaluate_decision_map(
+            classifier,
+            command_line::fixed,
+            command_line::density,
+            command_line::expand
+        );
+    }
+    catch( const char * message ) {
+        std::cerr << message << '\n';
+        return 2;
+    }
+    evaluate_timer.stop();
+
+    util::stats::timer write_timer( write_phase );
+    std::FILE * file = std::fopen( command_line::output_file_name.c_str(), "wb" );
+    if( file == nullptr ) {
+        std::cerr << "Could not open " << command_line::output_file_name << '\n';
+        return 3;
+    }
+    try {
+        write_decision_map( file, map, !command_line::raw );
+    }
+    catch( const char * message ) {
+        std::cerr << message << '\n';
+        std::fclose( file );
+        return 3;
+    }
+    if( std::fclose( file ) != 0 ) {
+        std::cerr << "Error writing " << command_line::output_file_name << '\n';
+        return 3;
+    }
+    return 0;
+}
@@ -16,6 +16,28 @@ namespace command_line {
 "    Chooses between simple linkage, full linkage or mean (average) linkage.\n"
 "    Default: simple.\n"
 "\n"
+"--linkage <name>\n"
+"    Chooses the linkage by name: simple, full, mean, ward,\n"
+"    centroid (distance between centroids),\n"
+"    median (distance between the midpoints of the children)\n"
+"    or weighted (average of the distances to the children).\n"
+"    With centroid and median linkages, a merge may happen\n"
+"    at a smaller distance than the merges of its children;\n"
+"    such children are drawn at the distance of their parent.\n"
+"\n"
+"--float\n"
+"    Store the distance matrix in single precision, halving its size.\n"
+"    Merges with very close linkage distances may change order.\n"
+"    Default: double precision.\n"
+"\n"
+"--mmap <file>\n"
+"    Keep the distance matrix in a memory-mapped file named <file>\n"
+"    instead of in memory, so that datasets whose matrix\n"
+"    does not fit in RAM can still be clustered.\n"
+"    <file> must not exist; the program refuses to overwrite it.\n"
+"    The file is deleted right after its creation.\n"
+"    Ignored for simple linkage, which needs no distance matrix.\n"
+"\n"
 "--normalize\n"
 "    Normalize the dataset to the interval [0, 1]\n"
 "    before creating the dendogram.\n"
@@ -66,11 +88,38 @@ namespace command_line {
 "    Default: writes the new dataset to stdout.\n"
 "    Avaliable only when performing the analysis.\n"
 "\n"
+"--profile\n"
+"    Writes to stdout, for each number of classes k from 1 to max-class,\n"
+"    the highest linkage distance inside the k classes\n"
+"    and the linkage delta (the linkage distance of the split\n"
+"    that created the k-th class minus the former distance),\n"
+"    as lines \"k,linkage,delta\". The delta of k = 1 is zero.\n"
+"    The optimum number of classes is the k between min-class and max-class\n"
+"    with the largest delta.\n"
+"    Avaliable only when performing the analysis.\n"
+"\n"
+"--cut <F>\n"
+"--cut-classes <N>\n"
+"    Cut the dendogram in flat classes,\n"
+"    splitting the classes while some has linkage distance above <F>,\n"
+"    or until there are <N> classes.\n"
+"    Both options may be given several times;\n"
+"    every cut is done on the same dendogram.\n"
+"    Writes to stdout a CSV table with the name of each entry\n"
+"    and its class (numbered from 0, left to right) in each cut,\n"
+"    in the order the options were given.\n"
+"    Cannot be used with the analysis.\n"
+"\n"
+"--stats\n"
+"    Print to stderr, at exit, the time spent in each phase\n"
+"    and counters like the number of merges.\n"
+"\n"
 "--help\n"
 "    Display this help and exit.\n"
 "\n";
 } // namespace command_line
 
+#include <algorithm>
 #include <cstdio>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -79,6 +128,7 @@ namespace command_line {
 #include "pr/dendogram_node.h"
 #include "pr/dendogram.h"
 #include "util/cv.h"
+#include "util/stats.h"
 
 namespace command_line {
     int width = 800;
@@ -93,6 +143,15 @@ namespace command_line {
     bool show_split = false;
     bool show_limits = false;
     bool write_classes = false;
+    bool write_profile = false;
+
+    // Each cut is either a threshold or a number of classes.
+    struct cut {
+        bool by_classes;
+        double threshold;
+        int classes;
+    };
+    std::vector< cut > cuts;
 
     bool normalize = false;
     bool standardize = false;
@@ -101,12 +160,14 @@ namespace command_line {
 
     LinkageDistanceFunction * linkage = SimpleLinkage;
     LinkageDistanceUpdateFunction * update = SimpleLinkageUpdate;
+    DistanceStorage storage;
 
     void parse( cmdline::args&& args ) {
         while( args.size() > 0 ) {
             std::string arg = args.next();
             if( arg == "--simple" ) {
                 linkage = SimpleLinkage;
+                update = SimpleLinkageUpdate;
                 continue;
             }
             if( arg == "--full" ) {
@@ -119,6 +180,25 @@ namespace command_line {
                 update = MeanLinkageUpdate;
                 continue;
             }
+            if( arg == "--linkage" ) {
+                std::string name = args.next();
+                const LinkageMethod * method = find_linkage_method( name );
+                if( method == nullptr ) {
+                    std::cerr << args.program_name() << ": Unknown linkage " << name << '\n';
+                    std::exit(1);
+                }
+                linkage = method->distance;
+                update = method->update;
+                continue;
+            }
+            if( arg == "--float" ) {
+                storage.single_precision = true;
+                continue;
+            }
+            if( arg == "--mmap" ) {
+                storage.file = args.next();
+                continue;
+            }
             if( arg == "--normalize" ) {
                 normalize = true;
                 continue;
@@ -169,6 +249,26 @@ namespace command_line {
                 write_classes = true;
                 continue;
             }
+            if( arg == "--profile" ) {
+                write_profile = true;
+                continue;
+            }
+            if( arg == "--cut" ) {
+                cut c{ false, 0.0, 0 };
+                args >> c.threshold;
+                cuts.push_back( c );
+                continue;
+            }
+            if( arg == "--cut-classes" ) {
+                cut c{ true, 0.0, 0 };
+                args.range(1) >> c.classes;
+                cuts.push_back( c );
+                continue;
+            }
+            if( arg == "--stats" ) {
+                util::stats::enable();
+                continue;
+            }
             if( arg == "--help" ) {
                 std::cout << args.program_name() << help_message;
                 std::exit(0);
@@ -176,6 +276,10 @@ namespace command_line {
             std::cerr << args.program_name() << ": Unknown option " << arg << '\n';
             std::exit(1);
         }
+        if( analyse && !cuts.empty() ) {
+            std::cerr << "It makes no sense to use both --cut and the analysis.\n";
+            std::exit(1);
+        }
         if( analyse ) {
             if( min_class == -1 ) {
                 std::cerr << "Must supply --min-class also to perform analysis.\n";
@@ -199,6 +303,10 @@ namespace command_line {
                 std::cerr << "--classes only avaliable when analysing.\n";
                 std::exit(1);
             }
+            if( write_profile ) {
+                std::cerr << "--profile only avaliable when analysing.\n";
+                std::exit(1);
+            }
         }
 
         if( normalize && standardize ) {
@@ -208,21 +316,32 @@ namespace command_line {
     }
 } // namespace command_line
 
+util::stats::phase parse_phase( "dendogram.parse_dataset" );
+util::stats::phase generate_phase( "dendogram.generate" );
+util::stats::phase draw_phase( "dendogram.draw" );
+util::stats::phase cut_phase( "dendogram.cut" );
+util::stats::phase analysis_phase( "dendogram.analysis" );
+
 int main( int argc, char ** argv ) {
     command_line::parse( cmdline::args(argc, argv) );
 
+    util::stats::timer parse_timer( parse_phase );
     DataSet dataset = DataSet::parse( stdin );
+    parse_timer.stop();
 
     if( command_line::normalize )
         dataset.normalize(0.0);
     if( command_line::standardize )
         dataset.standardize();
 
+    util::stats::timer generate_timer( generate_phase );
     auto dendogram = generate_dendogram(
         dataset,
         command_line::linkage,
-        command_line::update
+        command_line::update,
+        command_line::storage
     );
+    generate_timer.stop();
 
     cv::Mat img(
         command_line::height, command_line::width,
@@ -232,30 +351,83 @@ int main( int argc, char ** argv ) {
     int word_width;
 
     if( command_line::show_image || command_line::output_file_name != "" ) {
+        util::stats::timer timer( draw_phase );
         if( command_line::print_names )
-            word_width = util::print_named_dendogram( img, *dendogram );
+            word_width = util::print_named_dendogram( img, dendogram.root() );
         else {
             word_width = 0;
-            util::print_dendogram( img, *dendogram );
+            util::print_dendogram( img, dendogram.root() );
+        }
+    }
+
+    if( !command_line::cuts.empty() ) {
+        util::stats::timer timer( cut_phase );
+        std::vector< double > thresholds;
+        std::vector< int > class_counts;
+        for( const auto & cut : command_line::cuts )
+            if( cut.by_classes )
+                class_counts.push_back( cut.classes );
+            else
+                thresholds.push_back( cut.threshold );
+        auto by_threshold = cut_dendogram_thresholds( dendogram, thresholds );
+        auto by_classes = cut_dendogram_classes( dendogram, class_counts );
+
+        // Restore the order of the command line.
+        std::vector< const std::vector< int > * > labels;
+        std::size_t t = 0, c = 0;
+        std::printf( "name" );
+        for( const auto & cut : command_line::cuts ) {
+            if( cut.by_classes ) {
+                std::printf( ",k=%d", cut.classes );
+                labels.push_back( &by_classes[c++] );
+            }
+            else {
+                std::printf( ",t=%g", cut.threshold );
+                labels.push_back( &by_threshold[t++] );
+            }
+        }
+        std::printf( "\n" );
+
+        std::size_t i = 0;
+        for( const DataEntry & entry : dataset ) {
+            std::printf( "%s", entry.name().c_str() );
+            for( const auto * cut : labels )
+                std::printf( ",%d", (*cut)[i] );
+            std::printf( "\n" );
+            i++;
         }
     }
 
     if( command_line::analyse ) {
+        util::stats::timer timer( analysis_phase );
         auto data = classify_dendogram(
-            *dendogram,
+            dendogram.root(),
             command_line::min_class,
             command_line::max_class,
             dataset
         );
         if( command_line::write_classes )
             std::printf( "Optimum number of classes: %d\n", data.classes );
+        else if( command_line::write_profile ) {
+            auto root = dendogram.root();
+            auto profile = split_linkage_profile(
+                root, std::min<int>( command_line::max_class, root.size() - 1 )
+            );
+            double previous = root.linkage_distance();
+            for( int k = 1; k <= command_line::max_class; k++ ) {
+                // With every leaf in its own class, there is no linkage left.
+                double linkage = k - 1 < profile.size() ? profile[k - 1] : 0.0;
+                std::printf( "%d,%g,%g\n", k, linkage, k == 1 ? 0.0 : previous - linkage );
+                previous = linkage;
+            }
+        }
         else
             data.classified_dataset.write( stdout );
 
         int remaining_width = command_line::width - word_width;
 
         if( command_line::show_limits ) {
-            int pos = data.linkage_min_class / dendogram->linkage_distance() *
+            int pos = data.linkage_min_class / dendogram.root().linkage_distance() *
                 remaining_width + word_width;
             cv::line(
                 img,
@@ -263,7 +435,7 @@ int main( int argc, char ** argv ) {
                 cv::Scalar(128,128,128)
             );
 
-            pos = data.linkage_max_class / dendogram->linkage_distance() *
+            pos = data.linkage_max_class / dendogram.root().linkage_distance() *
                 remaining_width + word_width;
             cv::line(
                 img,
@@ -274,7 +446,7 @@ int main( int argc, char ** argv ) {
 
         if( command_line::show_split ) {
             int pos = (data.linkage_lower_limit + data.linkage_upper_limit) /
-                (2 * dendogram->linkage_distance()) * remaining_width + word_width;
+                (2 * dendogram.root().linkage_distance()) * remaining_width + word_width;
             cv::line(
                 img,
                 cv::Point(pos, 0), cv::Point(pos, command_line::height),
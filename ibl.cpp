@@ -56,16 +56,35 @@ namespace command_line {
 "    Default: 0.75.\n"
 "    This option is ignored for IBL 1 and 2.\n"
 "\n"
+"--shards <N>\n"
+"    Split the dataset into N contiguous pieces and train IBL 4\n"
+"    on each of them in parallel, merging the results afterwards.\n"
+"    Default: 1 (sequential training).\n"
+"    This option is ignored for IBL 1, 2 and 3.\n"
+"\n"
+"--compare-sequential\n"
+"    After the training, also train IBL 4 sequentially with the same seed\n"
+"    and print the training time and the accuracy over the input dataset\n"
+"    of both trainings.\n"
+"    This option is ignored for IBL 1, 2 and 3.\n"
+"\n"
+"--stats\n"
+"    Print to stderr, at exit, the time spent in each phase\n"
+"    and counters like the number of distance evaluations.\n"
+"\n"
 "--help\n"
 "    Display this help and quit.\n"
 ;
 } // namespace command_line
 
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "pr/ibl.h"
 #include "util/cv.h"
+#include "util/stats.h"
 
 namespace command_line {
     int width = 300;
@@ -85,6 +104,9 @@ namespace command_line {
     long long unsigned ibl_seed;
     bool ibl_seed_set = false;
 
+    unsigned shards = 1;
+    bool compare_sequential = false;
+
     void parse( cmdline::args&& args ) {
         while( args.size() > 0 ) {
             std::string arg = args.next();
@@ -136,6 +158,18 @@ namespace command_line {
                 ibl_seed_set = true;
                 continue;
             }
+            if( arg == "--shards" ) {
+                args.range( 1 ) >> shards;
+                continue;
+            }
+            if( arg == "--compare-sequential" ) {
+                compare_sequential = true;
+                continue;
+            }
+            if( arg == "--stats" ) {
+                util::stats::enable();
+                continue;
+            }
             if( arg == "--help" ) {
                 std::printf( help_message, args.program_name().c_str() );
                 std::exit(0);
@@ -146,10 +180,16 @@ namespace command_line {
     }
 } // namespace command_line
 
+util::stats::phase parse_phase( "ibl.parse_dataset" );
+util::stats::phase train_phase( "ibl.train" );
+util::stats::phase influence_areas_phase( "ibl.influence_areas" );
+
 int main( int argc, char ** argv ) {
     command_line::parse( cmdline::args(argc, argv) );
 
+    util::stats::timer parse_timer( parse_phase );
     DataSet dataset = DataSet::parse( stdin );
+    parse_timer.stop();
 
     if( command_line::noise != 0 ) {
         if( command_line::noise_seed_set ) {
@@ -192,10 +232,12 @@ int main( int argc, char ** argv ) {
             );
             if( false ) { // WARNING: entangled if and switch
         case 4:
-                ibl_ptr = std::make_unique<ibl3>(
+                auto ibl4_ptr = std::make_unique<ibl4>(
                     command_line::accept_threshold,
                     command_line::reject_threshold
                 );
+                ibl4_ptr->shards( command_line::shards );
+                ibl_ptr = std::move( ibl4_ptr );
             }
             { // begin common code
                 ibl3 * ibl3_ptr = (ibl3 *) ibl_ptr.get();
@@ -225,15 +267,53 @@ int main( int argc, char ** argv ) {
     util::show_dataset( left, dataset );
     cv::imshow( "IBL", img );
 
-    ibl.train( dataset );
+    auto start = std::chrono::steady_clock::now();
+    {
+        util::stats::timer timer( train_phase );
+        ibl.train( dataset );
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
     std::cout << "Hits: " << ibl.hit_count()
         << " - Misses: " << ibl.miss_count() << "\n";
 
+    if( command_line::compare_sequential && command_line::ibl == 4 ) {
+        /* Fraction of the input dataset correctly classified
+         * by the conceptual descriptor.
+         */
+        auto accuracy = [&]( const ::ibl & trained ) {
+            const NearestNeighbor & nn = trained.nearest_neighbor();
+            int correct = 0;
+            for( const DataEntry & entry : dataset )
+                if( nn.classify( entry ) == entry.categories() )
+                    correct++;
+            return (double) correct / dataset.size();
+        };
+
+        ibl4 sequential( command_line::accept_threshold, command_line::reject_threshold );
+        sequential.seed( ((ibl3 &) ibl).seed() );
+        auto sequential_start = std::chrono::steady_clock::now();
+        sequential.train( dataset );
+        std::chrono::duration<double> sequential_elapsed =
+            std::chrono::steady_clock::now() - sequential_start;
+
+        std::printf( "%-12s %10s %8s %8s %10s %9s\n",
+            "Training", "Time (s)", "Hits", "Misses", "Instances", "Accuracy" );
+        std::printf( "%-12s %10.3f %8d %8d %10zu %9.4f\n", "Sharded",
+            elapsed.count(), ibl.hit_count(), ibl.miss_count(),
+            ibl.conceptual_descriptor().size(), accuracy( ibl ) );
+        std::printf( "%-12s %10.3f %8d %8d %10zu %9.4f\n", "Sequential",
+            sequential_elapsed.count(), sequential.hit_count(), sequential.miss_count(),
+            sequential.conceptual_descriptor().size(), accuracy( sequential ) );
+    }
+
     util::show_dataset( middle, ibl.conceptual_descriptor() );
     cv::imshow( "IBL", img );
     cv::waitKey(10);
 
-    util::influence_areas( right, ibl.nearest_neighbor(), 0.1 );
+    {
+        util::stats::timer timer( influence_areas_phase );
+        util::influence_areas( right, ibl.nearest_neighbor(), 0.1 );
+    }
     cv::imshow( "IBL", img );
     cv::waitKey();
 
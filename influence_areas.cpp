@@ -34,6 +34,11 @@ namespace command_line {
 "    from the dataset's absolute borders.\n"
 "    Default: 0.1\n"
 "\n"
+"--brute-force\n"
+"    Classify every pixel of the image.\n"
+"    By default, only the pixels near the boundaries of the areas\n"
+"    are classified; the image is the same, but much faster.\n"
+"\n"
 "--help\n"
 "    Display this help and exit.\n"
 "\n"
@@ -47,6 +52,7 @@ namespace command_line {
 "--normalize\n"
 "--no-normalize\n"
 "--normalize-tolerance <F>\n"
+"--stats\n"
 ;
 } // namespace command_line
 
@@ -58,6 +64,7 @@ namespace command_line {
 #include "cmdline/args.hpp"
 #include "pr/classifier.h"
 #include "util/cv.h"
+#include "util/stats.h"
 
 namespace command_line {
     std::string output_file_name = "output.png";
@@ -70,6 +77,8 @@ namespace command_line {
     bool noise_seed_set = false;
     double noise_expand = 0.1;
 
+    bool brute_force = false;
+
     /* Arguments that will be passed to the classifier. */
     cmdline::args subargs;
 
@@ -97,7 +106,8 @@ namespace command_line {
              || arg == "--hamming"
              || arg == "--euclidean"
              || arg == "--normalize"
-             || arg == "--no-normalize" ) {
+             || arg == "--no-normalize"
+             || arg == "--stats" ) {
                 subargs.push_back( arg );
                 continue;
             }
@@ -106,6 +116,10 @@ namespace command_line {
                 subargs.push_back( args.next() );
                 continue;
             }
+            if( arg == "--brute-force" ) {
+                brute_force = true;
+                continue;
+            }
             if( arg == "--noise" ) {
                 args.range( 1 ) >> noise;
                 continue;
@@ -129,6 +143,9 @@ namespace command_line {
     }
 } // namespace command_line
 
+util::stats::phase render_phase( "influence_areas.render" );
+util::stats::phase write_phase( "influence_areas.write" );
+
 int main( int argc, char ** argv ) {
     using namespace command_line;
 
@@ -165,8 +182,12 @@ int main( int argc, char ** argv ) {
     }
 
     cv::Mat img( height, width, CV_8UC3, cv::Scalar(255, 255, 255) );
-    util::influence_areas( img, classifier, expand );
+    {
+        util::stats::timer timer( render_phase );
+        util::influence_areas( img, classifier, expand, command_line::brute_force );
+    }
 
+    util::stats::timer timer( write_phase );
     if( !cv::imwrite( output_file_name, img ) ) {
         std::cerr << "Error writing image to " << output_file_name << '\n';
         return 3;
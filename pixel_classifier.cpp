@@ -25,19 +25,70 @@ namespace command_line {
 "--euclidean\n"
 "    Chooses euclidean distance as similarity metric.\n"
 "\n"
+"--direct\n"
+"    Compute the similarity of every pixel in a single vectorized pass,\n"
+"    instead of classifying each distinct color of the image once.\n"
+"    Faster for images with many distinct colors.\n"
+"    The gray levels may differ by one, due to single-precision arithmetic.\n"
+"\n"
+"--class <name> <file>\n"
+"    Read a set of pixels labeled <name> from <file>,\n"
+"    in the same format of stdin, instead of reading stdin.\n"
+"    Can be given several times, to segment the image into several classes:\n"
+"    a model is fitted to each set, with the chosen metric,\n"
+"    and each pixel is painted with the color of the nearest class,\n"
+"    or black if its distance to every class is at least 1.\n"
+"    The image is scanned only once for all the classes.\n"
+"    Not compatible with --direct.\n"
+"\n"
+"--apply <path>\n"
+"    Apply the model calibrated on <image> to the image <path>,\n"
+"    or to every file in <path> if it is a directory.\n"
+"    Can be given several times. This enables the batch mode:\n"
+"    no window is shown, and each result is written to --output-dir\n"
+"    with the name of its input file.\n"
+"    Two inputs with the same name are an error,\n"
+"    even if they are in different directories.\n"
+"    <image> itself is classified only if --output is given.\n"
+"    Reading, classifying and writing consecutive images\n"
+"    happen at the same time, in different threads.\n"
+"\n"
+"--output-dir <dir>\n"
+"    Directory for the results of --apply; it must exist.\n"
+"\n"
+"--threads <N>\n"
+"    Number of threads used to classify the image.\n"
+"    Default: number of hardware threads.\n"
+"\n"
+"--stats\n"
+"    Print to stderr, at exit, the time spent in each phase\n"
+"    and counters like the number of distinct colors classified.\n"
+"    In batch mode, the reading, classification and writing overlap,\n"
+"    so their times add up to more than the total time.\n"
+"\n"
 "--help\n"
 "    Display this help and exit.\n"
 ;
 } // namespace command_line
 
+#include <algorithm>
 #include <cfloat>
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "cmdline/args.hpp"
 #include "util/csv.h"
 #include "util/cv.h"
+#include "util/parallel.hpp"
+#include "util/stats.h"
 #include "pr/classifier.h"
 #include "pr/grid_generator.h"
 #include "pr/mahalanobis.h"
@@ -49,6 +100,16 @@ namespace command_line {
 
     bool hamming = false;
     bool euclidean = false;
+    bool direct = false;
+
+    struct pixel_set {
+        std::string name;
+        std::string file;
+    };
+    std::vector< pixel_set > classes;
+
+    std::vector< std::string > batch;
+    std::string output_dir;
 
     void parse( cmdline::args&& args ) {
         while( args.size() > 0 ) {
@@ -72,6 +133,33 @@ namespace command_line {
                 euclidean = true;
                 continue;
             }
+            if( arg == "--direct" ) {
+                direct = true;
+                continue;
+            }
+            if( arg == "--class" ) {
+                pixel_set set;
+                set.name = args.next();
+                set.file = args.next();
+                classes.push_back( set );
+                continue;
+            }
+            if( arg == "--apply" ) {
+                batch.push_back( args.next() );
+                continue;
+            }
+            if( arg == "--output-dir" ) {
+                output_dir = args.next();
+                continue;
+            }
+            if( arg == "--threads" ) {
+                args.range( 1 ) >> util::thread_count();
+                continue;
+            }
+            if( arg == "--stats" ) {
+                util::stats::enable();
+                continue;
+            }
             if( arg == "--help" ) {
                 std::printf( help_message, args.program_name().c_str() );
                 std::exit(0);
@@ -88,15 +176,35 @@ namespace command_line {
             std::fprintf( stderr, "Missing image source in command-line.\n" );
             std::exit(1);
         }
+        if( direct && !classes.empty() ) {
+            std::fprintf( stderr, "--direct cannot be used with --class.\n" );
+            std::exit(1);
+        }
+        if( !batch.empty() && output_dir == "" ) {
+            std::fprintf( stderr, "--apply needs --output-dir.\n" );
+            std::exit(1);
+        }
     }
 } // namespace command_line
 
-int main( int argc, char ** argv ) {
-    command_line::parse( cmdline::args(argc, argv) );
+util::stats::phase read_phase( "pixel_classifier.read" );
+util::stats::phase calibrate_phase( "pixel_classifier.calibrate" );
+util::stats::phase classify_phase( "pixel_classifier.classify" );
+util::stats::phase write_phase( "pixel_classifier.write" );
 
-    auto data = util::parse_csv( stdin );
-    cv::Mat img = cv::imread( command_line::image );
+void write_output( const cv::Mat & img ) {
+    util::stats::timer timer( write_phase );
+    if( !cv::imwrite( command_line::output, img ) )
+        std::fprintf( stderr, "Error writing image to %s\n",
+            command_line::output.c_str()
+        );
+}
 
+/* Reads a list of pixel coordinates, in the format of pixel_chooser,
+ * and returns the dataset of the colors of these pixels in the image.
+ */
+DataSet read_pixels( const cv::Mat & img, std::FILE * file ) {
+    auto data = util::parse_csv( file );
     DataSet dataset( 3, 0 );
     for( unsigned i = 0; i < data.size(); ++i )
         /* opencv's dimension access order is row/column.
@@ -105,39 +213,279 @@ int main( int argc, char ** argv ) {
         dataset.push_back( util::entryFromVec(
             img.at<cv::Vec3b>(data[i][1], data[i][0])
         ));
+    return dataset;
+}
 
-    std::unique_ptr< DistanceCalculator > distance_ptr;
+std::unique_ptr< DistanceCalculator > make_distance() {
     if( command_line::euclidean )
-        distance_ptr = std::make_unique<EuclideanDistance>(0);
-    else if( command_line::hamming )
-        distance_ptr = std::make_unique<ManhattanDistance>(0);
-    else
-        distance_ptr = std::make_unique<MahalanobisDistance>();
-    DistanceCalculator & distance = *distance_ptr;
-    distance.calibrate(dataset);
+        return std::make_unique<EuclideanDistance>(0);
+    if( command_line::hamming )
+        return std::make_unique<ManhattanDistance>(0);
+    return std::make_unique<MahalanobisDistance>();
+}
+
+/* Classification of whole images, calibrated on the reference image.
+ * It is called for one image at a time,
+ * but it may use several threads for that image.
+ */
+typedef std::function< void( cv::Mat & ) > image_classifier;
+
+/* Paints each pixel with the color of the nearest class,
+ * for the classes given with --class.
+ * Each distinct color is measured against every model in a single pass.
+ */
+image_classifier segmenter( const cv::Mat & reference ) {
+    struct model {
+        DataEntry mean;
+        std::unique_ptr< DistanceCalculator > distance;
+        cv::Vec3b color;
+    };
+    auto models = std::make_shared< std::vector< model > >();
+    for( const auto & set : command_line::classes ) {
+        std::FILE * file = std::fopen( set.file.c_str(), "r" );
+        if( file == nullptr ) {
+            std::fprintf( stderr, "Could not open %s\n", set.file.c_str() );
+            std::exit(1);
+        }
+        DataSet dataset = read_pixels( reference, file );
+        std::fclose( file );
+
+        auto distance = make_distance();
+        distance->calibrate( dataset );
+        cv::Scalar color = util::category_color( set.name );
+        models->push_back( model{
+            dataset.mean(),
+            std::move( distance ),
+            cv::Vec3b( color[0], color[1], color[2] )
+        });
+    }
+
+    return [models]( cv::Mat & img ) {
+        util::map_colors( img, [&]( const cv::Vec3b & color ) {
+            DataEntry entry = util::entryFromVec( color );
+            double nearest = 1;
+            cv::Vec3b result( 0, 0, 0 );
+            for( const model & m : *models ) {
+                double dist = (*m.distance)( m.mean, entry );
+                if( dist < nearest ) {
+                    nearest = dist;
+                    result = m.color;
+                }
+            }
+            return result;
+        });
+    };
+}
+
+/* Paints each pixel with a gray level,
+ * according to its distance to the pixel set read from stdin.
+ */
+image_classifier similarity( const cv::Mat & reference ) {
+    DataSet dataset = read_pixels( reference, stdin );
+
+    std::shared_ptr< DistanceCalculator > distance = make_distance();
+    distance->calibrate(dataset);
 
     DataEntry mean = dataset.mean();
 
-    auto it = img.begin<cv::Vec3b>(), end = img.end<cv::Vec3b>();
-    for( ; it != end; ++it ) {
-        DataEntry entry = util::entryFromVec( *it );
+    if( command_line::direct ) {
+        /* All three distances are a linear transform followed by a norm;
+         * see util::LinearColorDistance.
+         */
+        util::LinearColorDistance linear;
+        for( int i = 0; i < 3; i++ )
+            linear.origin[i] = mean.attribute(i);
+
+        if( command_line::euclidean || command_line::hamming ) {
+            auto & normalizing = static_cast< NormalizingDistanceCalculator & >( *distance );
+            for( int i = 0; i < 3; i++ )
+                for( int j = 0; j < 3; j++ )
+                    linear.transform[i][j] = i == j ? normalizing.scale(i) : 0;
+            linear.p = command_line::euclidean ? 2 : 1;
+        }
+        else {
+            cv::Mat_<double> w = static_cast< MahalanobisDistance & >( *distance ).whitening();
+            for( int i = 0; i < 3; i++ )
+                for( int j = 0; j < 3; j++ )
+                    linear.transform[i][j] = w(i, j);
+            linear.p = 2;
+        }
+        return [linear]( cv::Mat & img ) {
+            util::similarity_map( img, linear );
+        };
+    }
+
+    return [distance, mean]( cv::Mat & img ) {
+        util::map_colors( img, [&]( const cv::Vec3b & color ) {
+            double dist = (*distance)( mean, util::entryFromVec( color ) );
+            double sim; // similarity
+            if( dist > 1 )
+                sim = 0;
+            else
+                sim = 1 - dist;
+
+            return cv::Vec3b(255 * sim, 255 * sim, 255 * sim);
+        });
+    };
+}
 
-        double dist = distance( mean, entry );
-        double sim; // similarity
-        if( dist > 1 )
-            sim = 0;
-        else
-            sim = 1 - dist;
+// Name of the result of the input file in batch mode.
+std::string output_name( const std::string & file ) {
+    std::string base = file.substr( file.find_last_of( '/' ) + 1 );
+    return command_line::output_dir + "/" + base;
+}
+
+/* Lists the images given with --apply, expanding directories.
+ * The files of each directory are sorted by name.
+ * Exits if two of them would be written to the same output file.
+ */
+std::vector< std::string > batch_files() {
+    std::vector< std::string > files;
+    for( const std::string & path : command_line::batch ) {
+        struct stat info;
+        if( stat( path.c_str(), &info ) != 0 ) {
+            std::fprintf( stderr, "Could not find %s\n", path.c_str() );
+            std::exit(1);
+        }
+        if( !S_ISDIR( info.st_mode ) ) {
+            files.push_back( path );
+            continue;
+        }
 
-        *it = cv::Vec3b(255 * sim, 255 * sim, 255 * sim);
+        DIR * dir = opendir( path.c_str() );
+        if( dir == nullptr ) {
+            std::fprintf( stderr, "Could not open the directory %s\n", path.c_str() );
+            std::exit(1);
+        }
+        std::vector< std::string > entries;
+        while( dirent * entry = readdir( dir ) ) {
+            std::string file = path + "/" + entry->d_name;
+            if( entry->d_name[0] != '.' &&
+                stat( file.c_str(), &info ) == 0 && S_ISREG( info.st_mode ) )
+                entries.push_back( file );
+        }
+        closedir( dir );
+        std::sort( entries.begin(), entries.end() );
+        files.insert( files.end(), entries.begin(), entries.end() );
     }
 
-    if( command_line::output != "" ) {
-        if( !cv::imwrite( command_line::output, img ) )
-            std::fprintf( stderr, "Error writing image to %s\n",
-                command_line::output.c_str()
+    std::map< std::string, std::string > inputs;
+    for( const std::string & file : files ) {
+        auto pair = inputs.insert( {output_name( file ), file} );
+        if( !pair.second ) {
+            std::fprintf( stderr, "Both %s and %s would be written to %s\n",
+                pair.first->second.c_str(), file.c_str(), pair.first->first.c_str()
             );
+            std::exit(1);
+        }
     }
+    return files;
+}
+
+/* Classifies every image given with --apply, without any window.
+ *
+ * The work is a three-stage pipeline:
+ * one thread reads the images, the main thread classifies them
+ * (using util::thread_count() threads for each image),
+ * and another thread writes the results.
+ * The queues between the stages hold only a few images,
+ * so the memory stays bounded however many images there are.
+ */
+void run_batch( const image_classifier & classify ) {
+    struct frame {
+        std::string name;
+        cv::Mat img;
+    };
+    const std::size_t depth = 4;
+    util::bounded_queue< frame > decoded( depth );
+    util::bounded_queue< frame > classified( depth );
+    std::vector< std::string > files = batch_files();
+
+    std::thread reader( [&]() {
+        for( const std::string & file : files ) {
+            util::stats::timer read_timer( read_phase );
+            frame f{ file, cv::imread( file ) };
+            read_timer.stop();
+            if( f.img.empty() ) {
+                std::fprintf( stderr, "Could not read the image %s\n", file.c_str() );
+                continue;
+            }
+            if( !decoded.push( std::move(f) ) )
+                break;
+        }
+        decoded.close();
+    });
+
+    std::thread writer( [&]() {
+        frame f;
+        while( classified.pop( f ) ) {
+            std::string output = output_name( f.name );
+            util::stats::timer timer( write_phase );
+            /* imwrite throws, instead of returning false,
+             * for some errors like unknown extensions;
+             * either way, the other images are still written.
+             */
+            try {
+                if( !cv::imwrite( output, f.img ) )
+                    std::fprintf( stderr, "Error writing image to %s\n", output.c_str() );
+            }
+            catch( const cv::Exception & e ) {
+                std::fprintf( stderr, "Error writing image to %s: %s\n", output.c_str(), e.what() );
+            }
+        }
+    });
+
+    try {
+        frame f;
+        while( decoded.pop( f ) ) {
+            util::stats::timer classify_timer( classify_phase );
+            classify( f.img );
+            classify_timer.stop();
+            classified.push( std::move(f) );
+        }
+    }
+    catch( ... ) {
+        decoded.close();
+        classified.close();
+        reader.join();
+        writer.join();
+        throw;
+    }
+    classified.close();
+    reader.join();
+    writer.join();
+}
+
+int main( int argc, char ** argv ) {
+    command_line::parse( cmdline::args(argc, argv) );
+
+    util::stats::timer read_timer( read_phase );
+    cv::Mat img = cv::imread( command_line::image );
+    read_timer.stop();
+
+    util::stats::timer calibrate_timer( calibrate_phase );
+    image_classifier classify = command_line::classes.empty() ?
+        similarity( img ) : segmenter( img );
+    calibrate_timer.stop();
+
+    auto timed_classify = [&]( cv::Mat & target ) {
+        util::stats::timer timer( classify_phase );
+        classify( target );
+    };
+
+    if( !command_line::batch.empty() ) {
+        if( command_line::output != "" ) {
+            timed_classify( img );
+            write_output( img );
+        }
+        run_batch( classify );
+        return 0;
+    }
+
+    timed_classify( img );
+
+    if( command_line::output != "" )
+        write_output( img );
 
     cv::namedWindow( "Mahalanobis", CV_WINDOW_AUTOSIZE );
     cv::imshow( "Mahalanobis", img );
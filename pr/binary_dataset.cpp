@@ -0,0 +1,92 @@
+/* Implementation of binary_dataset.h.
+ */
+#include <map>
+#include "binary_dataset.h"
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+#include "util/binary_io.hpp"
+
+namespace {
+    const char magic[4] = {'P', 'R', 'D', 'B'};
+    const std::uint32_t version = 1;
+
+    const char * const write_error = "Error writing the binary dataset.";
+    const char * const truncated = "Truncated binary dataset.";
+} // anonymous namespace
+
+std::size_t BinaryDatasetHeader::entry_size() const {
+    return attribute_names.size() * sizeof(double) + sizeof(std::uint32_t);
+}
+
+void write_binary_header( std::FILE * file, const BinaryDatasetHeader & header ) {
+    util::put_signature( file, magic, version, write_error );
+
+    util::put< std::uint32_t >( file, header.attribute_names.size(), write_error );
+    for( const std::string & name : header.attribute_names )
+        util::put_string( file, name, write_error );
+    util::put_string( file, header.category_name, write_error );
+    util::put< std::uint32_t >( file, header.category_values.size(), write_error );
+    for( const std::string & value : header.category_values )
+        util::put_string( file, value, write_error );
+    util::put< std::uint64_t >( file, header.entry_count, write_error );
+}
+
+BinaryDatasetHeader read_binary_header( std::FILE * file ) {
+    util::check_signature( file, magic, version,
+        "Not a binary dataset.", "Unsupported binary dataset version.", truncated );
+
+    BinaryDatasetHeader header;
+    header.attribute_names.resize( util::get< std::uint32_t >( file, truncated ) );
+    for( std::string & name : header.attribute_names )
+        name = util::get_string( file, truncated );
+    header.category_name = util::get_string( file, truncated );
+    header.category_values.resize( util::get< std::uint32_t >( file, truncated ) );
+    for( std::string & value : header.category_values )
+        value = util::get_string( file, truncated );
+    header.entry_count = util::get< std::uint64_t >( file, truncated );
+    return header;
+}
+
+void write_binary_dataset( std::FILE * file, const DataSet & dataset ) {
+    if( dataset.category_count() != 1 )
+        throw "The dataset must have exactly one category type.";
+
+    BinaryDatasetHeader header;
+    for( std::size_t i = 0; i < dataset.attribute_count(); i++ )
+        header.attribute_names.push_back( dataset.attribute_name( i ) );
+    header.category_name = dataset.category_name( 0 );
+    header.entry_count = dataset.size();
+
+    std::map< std::string, std::uint32_t > index;
+    for( const DataEntry & entry : dataset )
+        if( index.insert( {entry.category(0), header.category_values.size()} ).second )
+            header.category_values.push_back( entry.category(0) );
+
+    write_binary_header( file, header );
+    for( const DataEntry & entry : dataset ) {
+        for( std::size_t i = 0; i < dataset.attribute_count(); i++ )
+            util::put< double >( file, entry.attribute( i ), write_error );
+        util::put< std::uint32_t >( file, index[entry.category(0)], write_error );
+    }
+}
+
+DataSet read_binary_dataset( std::FILE * file ) {
+    BinaryDatasetHeader header = read_binary_header( file );
+    std::size_t attribute_count = header.attribute_names.size();
+    std::uint64_t entry_count = header.entry_count;
+
+    std::vector< DataEntry > entries;
+    for( std::uint64_t k = 0; k < entry_count; k++ ) {
+        std::vector< double > attributes( attribute_count );
+        util::get_array( file, attributes.data(), attribute_count, truncated );
+        std::uint32_t category = util::get< std::uint32_t >( file, truncated );
+        if( category >= header.category_values.size() )
+            throw "Binary dataset category out of range.";
+        entries.push_back( DataEntry( std::move(attributes), {header.category_values[category]} ) );
+    }
+    return DataSet(
+        std::move(header.attribute_names),
+        {header.category_name},
+        std::move(entries)
+    );
+}
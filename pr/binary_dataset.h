@@ -0,0 +1,61 @@
+#ifndef PR_BINARY_DATASET_H
+#define PR_BINARY_DATASET_H
+
+/* Binary datasets, for inputs too large to parse as text.
+ *
+ * Only datasets with exactly one category type are supported.
+ * The file is written in the native byte order:
+ *
+ *      char[4]     "PRDB"
+ *      uint32      version (1)
+ *      uint32      number of attributes
+ *          uint32  length of the name
+ *          char[]  name (without terminator)
+ *      uint32      length of the category name
+ *      char[]      category name
+ *      uint32      number of category values
+ *          uint32  length of the value
+ *          char[]  value
+ *      uint64      number of entries
+ *      the entries, each one as
+ *          double  value of each attribute
+ *          uint32  index of the category value
+ *
+ * The entries have a fixed size, so they can be written in blocks
+ * by several threads; see datatools/generate_dataset.cpp.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+class DataSet;
+
+struct BinaryDatasetHeader {
+    std::vector< std::string > attribute_names;
+    std::string category_name;
+    std::vector< std::string > category_values;
+    std::uint64_t entry_count;
+
+    // Size, in bytes, of each entry.
+    std::size_t entry_size() const;
+};
+
+/* Writes/reads the header of a binary dataset.
+ * The file is left at the first entry.
+ * Both functions throw on input/output errors,
+ * and read_binary_header also throws on malformed files.
+ */
+void write_binary_header( std::FILE *, const BinaryDatasetHeader & );
+BinaryDatasetHeader read_binary_header( std::FILE * );
+
+/* Writes/reads a whole binary dataset.
+ * The category values are listed in the order they appear in the dataset.
+ * Throws if the dataset does not have exactly one category type,
+ * and on the same errors as the functions above.
+ */
+void write_binary_dataset( std::FILE *, const DataSet & );
+DataSet read_binary_dataset( std::FILE * );
+
+#endif // PR_BINARY_DATASET_H
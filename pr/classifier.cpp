@@ -7,6 +7,12 @@
 #include "pr/ibl.h"
 #include "pr/nearest_neighbor.h"
 #include "pr/p_norm.h"
+#include "util/stats.h"
+
+namespace {
+    util::stats::phase parse_phase( "classifier.parse_dataset" );
+    util::stats::phase ibl_phase( "classifier.ibl_training" );
+} // anonymous namespace
 
 std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
     double tolerance = 0.1;
@@ -29,6 +35,8 @@ std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
     double reject_threshold = 0.75;
     long long unsigned ibl_seed;
     bool ibl_seed_set = false;
+    unsigned shards = 1;
+    unsigned raster = 0;
 
     while( args.size() > 0 ) {
         std::string arg = args.next();
@@ -113,6 +121,18 @@ std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
             ibl_seed_set = true;
             continue;
         }
+        if( arg == "--shards" ) {
+            args.range( 1 ) >> shards;
+            continue;
+        }
+        if( arg == "--raster" ) {
+            args.range( 1 ) >> raster;
+            continue;
+        }
+        if( arg == "--stats" ) {
+            util::stats::enable();
+            continue;
+        }
         if( arg == "--help" ) {
             std::cout << args.program_name() << classifier_help_message;
             std::exit(0);
@@ -126,12 +146,15 @@ std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
     std::unique_ptr<DataSet> dataset;
     std::unique_ptr<DistanceCalculator> calculator;
 
-    if( dataset_file == nullptr ) {
-        dataset = std::make_unique<DataSet>(DataSet::parse( stdin ));
-    }
-    else {
-        dataset = std::make_unique<DataSet>(DataSet::parse( dataset_file ));
-        std::fclose(dataset_file);
+    {
+        util::stats::timer timer( parse_phase );
+        if( dataset_file == nullptr ) {
+            dataset = std::make_unique<DataSet>(DataSet::parse( stdin ));
+        }
+        else {
+            dataset = std::make_unique<DataSet>(DataSet::parse( dataset_file ));
+            std::fclose(dataset_file);
+        }
     }
 
     if( noise != 0 ) {
@@ -165,7 +188,9 @@ std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
                 ibl_ptr = std::make_unique<ibl3>(accept_threshold, reject_threshold);
                 if( false ) { // WARNING: entangled if and switch
             case 4:
-                    ibl_ptr = std::make_unique<ibl3>(accept_threshold, reject_threshold);
+                    auto ibl4_ptr = std::make_unique<ibl4>(accept_threshold, reject_threshold);
+                    ibl4_ptr->shards( shards );
+                    ibl_ptr = std::move( ibl4_ptr );
                 }
                 { // begin common code
                     ibl3 * ibl3_ptr = (ibl3 *) ibl_ptr.get();
@@ -176,7 +201,10 @@ std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
                 } // end common code
                 break;
         }
-        ibl_ptr->train( *dataset );
+        {
+            util::stats::timer timer( ibl_phase );
+            ibl_ptr->train( *dataset );
+        }
         std::cout << "Hits: " << ibl_ptr->hit_count()
             << " - Misses: " << ibl_ptr->miss_count() << "\n";
         dataset.reset( new DataSet(ibl_ptr->conceptual_descriptor()) );
@@ -187,10 +215,20 @@ std::unique_ptr<NearestNeighbor> generate_classifier( cmdline::args&& args ) {
     else
         calculator = std::make_unique<ManhattanDistance>( tolerance );
 
-    return std::make_unique<NearestNeighbor>(
+    auto classifier = std::make_unique<NearestNeighbor>(
         std::move(dataset),
         std::move(calculator),
         neighbors,
         normalize
     );
+    if( raster != 0 ) {
+        try {
+            classifier->rasterize( raster );
+        }
+        catch( const char * message ) {
+            std::cerr << message << '\n';
+            std::exit(1);
+        }
+    }
+    return classifier;
 }
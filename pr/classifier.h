@@ -97,6 +97,26 @@ constexpr char classifier_help_message[] =
 "    Default: 0.75.\n"
 "    This option is ignored for IBL 1 and 2.\n"
 "\n"
+"--shards <N>\n"
+"    Split the dataset into N contiguous pieces and train IBL 4\n"
+"    on each of them in parallel, merging the results afterwards.\n"
+"    Faster on large datasets, but not equivalent to the sequential training.\n"
+"    Default: 1 (sequential training).\n"
+"    This option is ignored for IBL 1, 2 and 3.\n"
+"\n"
+"--raster <N>\n"
+"    Divide the box of the dataset in N cells per attribute\n"
+"    and precompute the category of every cell\n"
+"    that lies entirely inside a single decision region.\n"
+"    Queries in these cells are answered by a table lookup;\n"
+"    the other queries use the usual search. The answers are the same.\n"
+"    The table has N^d cells, so use it only for few attributes.\n"
+"    Default: no table.\n"
+"\n"
+"--stats\n"
+"    Print to stderr, at exit, the time spent in each phase\n"
+"    and counters like the number of distance evaluations.\n"
+"\n"
 "--help\n"
 "    Display this help and quit.\n"
 ;
@@ -0,0 +1,354 @@
+/* Implementation of decision_map.h.
+ */
+#include <algorithm>
+#include <map>
+#include <utility>
+#include "decision_map.h"
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+#include "pr/grid_generator.h"
+#include "pr/nearest_neighbor.h"
+#include "util/binary_io.hpp"
+#include "util/parallel.hpp"
+#include "util/stats.h"
+
+namespace {
+    // Blocks of the quadtree subdivision; a point classified alone is a block.
+    util::stats::counter quadtree_blocks( "classify_plane.quadtree_blocks" );
+} // anonymous namespace
+
+DecisionMap evaluate_decision_map(
+    const NearestNeighbor & classifier,
+    const std::vector< DecisionMap::fixed_attribute > & fixed,
+    unsigned density,
+    double expand
+) {
+    const DataSet & dataset = classifier.dataset();
+    if( dataset.category_count() != 1 )
+        throw "The dataset must have exactly one category type.";
+    std::size_t attribute_count = dataset.attribute_count();
+
+    std::vector< bool > is_fixed( attribute_count, false );
+    for( const auto & f : fixed ) {
+        if( f.attribute >= attribute_count )
+            throw "Fixed attribute out of range.";
+        if( is_fixed[f.attribute] )
+            throw "Attribute fixed twice.";
+        is_fixed[f.attribute] = true;
+    }
+    std::vector< unsigned > free;
+    for( unsigned a = 0; a < attribute_count; a++ )
+        if( !is_fixed[a] )
+            free.push_back( a );
+
+    DecisionMap map;
+    map.fixed = fixed;
+
+    std::map< std::string, std::uint16_t > index;
+    for( const DataEntry & entry : dataset ) {
+        auto pair = index.insert( {entry.category(0), (std::uint16_t) map.categories.size()} );
+        if( pair.second ) {
+            if( map.categories.size() == 0xffff )
+                throw "Too many categories for a decision map.";
+            map.categories.push_back( entry.category(0) );
+        }
+    }
+
+    // The grid is calibrated on the projection of the dataset on the axes.
+    DataSet projection( free.size(), 0 );
+    for( const DataEntry & entry : dataset ) {
+        std::vector< double > attributes( free.size() );
+        for( std::size_t i = 0; i < free.size(); i++ )
+            attributes[i] = entry.attribute( free[i] );
+        projection.push_back( DataEntry( std::move(attributes), {} ) );
+    }
+    GridGenerator grid;
+    grid.expand( expand );
+    grid.density( std::vector< unsigned >( free.size(), density ) );
+    grid.calibrate( projection );
+
+    for( std::size_t i = 0; i < free.size(); i++ ) {
+        double first = grid.coordinate( i, 0 );
+        double step = density == 0 ? 0 : grid.coordinate( i, 1 ) - first;
+        map.axes.push_back( {free[i], density + 1, first, step} );
+    }
+
+    /* Each block of points is written to a single buffer,
+     * and classified with a single query entry.
+     */
+    map.labels.resize( grid.size() );
+    classifier.recalibrate();
+    util::parallel_blocks( 0, grid.size(), 1024, [&]( std::size_t begin, std::size_t end ) {
+        std::vector< double > points( (end - begin) * free.size() );
+        grid.fill( begin, end - begin, points.data() );
+
+        DataEntry query( std::vector< double >( attribute_count ), {} );
+        for( const auto & f : fixed )
+            query.attribute( f.attribute ) = f.value;
+
+        for( std::size_t k = 0; k < end - begin; k++ ) {
+            for( std::size_t i = 0; i < free.size(); i++ )
+                query.attribute( free[i] ) = points[k * free.size() + i];
+            map.labels[begin + k] = index.at( classifier.classify( query )[0] );
+        }
+    });
+    return map;
+}
+
+std::vector< std::uint16_t > classify_plane(
+    const NearestNeighbor & classifier,
+    const std::vector< double > & xs,
+    const std::vector< double > & ys,
+    bool brute_force
+) {
+    const DataSet & dataset = classifier.dataset();
+    if( dataset.attribute_count() != 2 )
+        throw "The dataset must have exactly two attributes.";
+    if( dataset.category_count() != 1 )
+        throw "The dataset must have exactly one category type.";
+    if( xs.size() > 0x7fffffff || ys.size() > 0x7fffffff )
+        throw "Too many points in the plane.";
+    int columns = xs.size();
+    int rows = ys.size();
+
+    // The category of each entry is kept as an index into the categories.
+    std::map< std::string, std::uint16_t > index;
+    std::vector< std::uint16_t > entry_category;
+    for( const DataEntry & entry : dataset ) {
+        auto pair = index.insert( {entry.category(0), (std::uint16_t) index.size()} );
+        if( pair.second && index.size() > 0xffff )
+            throw "Too many categories for a decision map.";
+        entry_category.push_back( pair.first->second );
+    }
+    std::size_t categories = index.size();
+    std::size_t neighbors = classifier.neighbor_count();
+    classifier.recalibrate();
+
+    std::vector< std::uint16_t > labels( xs.size() * ys.size() );
+
+    /* The plane is divided in square tiles, which are classified concurrently.
+     * Each tile reuses a single query entry,
+     * and writes straight into its own labels.
+     */
+    const int tile = 32;
+    int tiles_x = (columns + tile - 1) / tile;
+    int tiles_y = (rows + tile - 1) / tile;
+    util::parallel_for( 0, tiles_x * tiles_y, [&]( std::size_t t ) {
+        int x0 = (t % tiles_x) * tile;
+        int y0 = (t / tiles_x) * tile;
+        int x1 = std::min( x0 + tile, columns );
+        int y1 = std::min( y0 + tile, rows );
+        DataEntry query( {0.0, 0.0}, {} );
+
+        auto fill = [&]( int xa, int ya, int xb, int yb, std::uint16_t category ) {
+            for( int y = ya; y < yb; y++ )
+                for( int x = xa; x < xb; x++ )
+                    labels[(std::size_t) y * columns + x] = category;
+        };
+        auto classify = [&]( int x, int y ) {
+            query.attribute(0) = xs[x];
+            query.attribute(1) = ys[y];
+            fill( x, y, x + 1, y + 1, index.at( classifier.classify(query)[0] ) );
+        };
+
+        if( brute_force || neighbors == 0 || dataset.size() < neighbors ) {
+            for( int y = y0; y < y1; y++ )
+                for( int x = x0; x < x1; x++ )
+                    classify( x, y );
+            quadtree_blocks.add( (y1 - y0) * (x1 - x0) );
+            return;
+        }
+
+        /* Quadtree subdivision of the tile.
+         * Each block [xa, xb) x [ya, yb) has a list of candidates:
+         * the entries that may be among the nearest neighbors of its points,
+         * narrowed down by NearestNeighbor::candidates at each block.
+         *
+         * If the remaining candidates have the same category,
+         * all of the votes go to that category, and the block is filled;
+         * otherwise the block is split in four, with the remaining candidates.
+         * Single points are classified by the votes of the candidates;
+         * only draws go to the classifier,
+         * which may need more voters to resolve them.
+         */
+        struct block {
+            int xa, ya, xb, yb;
+            std::vector< std::size_t > candidates;
+        };
+        std::vector< block > blocks( 1 );
+        blocks[0] = { x0, y0, x1, y1, std::vector< std::size_t >( dataset.size() ) };
+        for( std::size_t i = 0; i < dataset.size(); i++ )
+            blocks[0].candidates[i] = i;
+        std::size_t block_count = 0;
+
+        while( !blocks.empty() ) {
+            block b = std::move( blocks.back() );
+            blocks.pop_back();
+            block_count++;
+
+            auto candidates = classifier.candidates(
+                {xs[b.xa], ys[b.ya]},
+                {xs[b.xb - 1], ys[b.yb - 1]},
+                b.candidates
+            );
+            // Nothing remains only if some distance is NaN.
+            if( candidates.empty() ) {
+                for( int y = b.ya; y < b.yb; y++ )
+                    for( int x = b.xa; x < b.xb; x++ )
+                        classify( x, y );
+                continue;
+            }
+
+            /* The candidates are kept in the order of the dataset,
+             * so the nearest one is the first in case of ties,
+             * like in NearestNeighbor::classify.
+             */
+            std::vector< std::size_t > remaining;
+            std::size_t nearest = 0;
+            bool agree = true;
+            for( std::size_t i = 0; i < candidates.size(); i++ ) {
+                std::size_t c = candidates[i].first;
+                if( candidates[i].second < candidates[nearest].second )
+                    nearest = i;
+                if( !remaining.empty() && entry_category[c] != entry_category[remaining[0]] )
+                    agree = false;
+                remaining.push_back( c );
+            }
+
+            if( agree ) {
+                fill( b.xa, b.ya, b.xb, b.yb, entry_category[remaining[0]] );
+                continue;
+            }
+            if( b.xb - b.xa == 1 && b.yb - b.ya == 1 ) {
+                if( neighbors == 1 ) {
+                    fill( b.xa, b.ya, b.xb, b.yb, entry_category[candidates[nearest].first] );
+                    continue;
+                }
+                /* The neighbors of the point are among the candidates,
+                 * so the votes are counted here, unless there is a draw.
+                 */
+                std::vector< std::pair< double, std::size_t > > voters;
+                for( const auto & candidate : candidates )
+                    voters.push_back( {candidate.second, candidate.first} );
+                std::partial_sort( voters.begin(), voters.begin() + neighbors, voters.end() );
+                std::vector< unsigned > votes( categories );
+                for( std::size_t i = 0; i < neighbors; i++ )
+                    votes[entry_category[voters[i].second]]++;
+                auto winner = std::max_element( votes.begin(), votes.end() );
+                if( std::count( votes.begin(), votes.end(), *winner ) == 1 )
+                    fill( b.xa, b.ya, b.xb, b.yb, winner - votes.begin() );
+                else
+                    classify( b.xa, b.ya );
+                continue;
+            }
+
+            int xm = b.xb - b.xa > 1 ? (b.xa + b.xb) / 2 : b.xb;
+            int ym = b.yb - b.ya > 1 ? (b.ya + b.yb) / 2 : b.yb;
+            blocks.push_back( {b.xa, b.ya, xm, ym, remaining} );
+            if( xm < b.xb )
+                blocks.push_back( {xm, b.ya, b.xb, ym, remaining} );
+            if( ym < b.yb )
+                blocks.push_back( {b.xa, ym, xm, b.yb, remaining} );
+            if( xm < b.xb && ym < b.yb )
+                blocks.push_back( {xm, ym, b.xb, b.yb, remaining} );
+        }
+        quadtree_blocks.add( block_count );
+    });
+    return labels;
+}
+
+namespace {
+    const char magic[4] = {'D', 'M', 'A', 'P'};
+    const std::uint32_t version = 1;
+
+    const char * const write_error = "Error writing the decision map.";
+    const char * const truncated = "Truncated decision map.";
+} // anonymous namespace
+
+void write_decision_map( std::FILE * file, const DecisionMap & map, bool run_length ) {
+    util::put_signature( file, magic, version, write_error );
+
+    util::put< std::uint32_t >( file, map.axes.size(), write_error );
+    for( const auto & axis : map.axes ) {
+        util::put< std::uint32_t >( file, axis.attribute, write_error );
+        util::put< std::uint32_t >( file, axis.points, write_error );
+        util::put< double >( file, axis.first, write_error );
+        util::put< double >( file, axis.step, write_error );
+    }
+    util::put< std::uint32_t >( file, map.fixed.size(), write_error );
+    for( const auto & f : map.fixed ) {
+        util::put< std::uint32_t >( file, f.attribute, write_error );
+        util::put< double >( file, f.value, write_error );
+    }
+    util::put< std::uint32_t >( file, map.categories.size(), write_error );
+    for( const std::string & name : map.categories )
+        util::put_string( file, name, write_error );
+
+    util::put< std::uint8_t >( file, run_length ? 1 : 0, write_error );
+    if( !run_length ) {
+        util::put_array( file, map.labels.data(), map.labels.size(), write_error );
+        return;
+    }
+
+    std::vector< std::pair< std::uint32_t, std::uint16_t > > runs;
+    for( std::uint16_t label : map.labels ) {
+        if( !runs.empty() && runs.back().second == label && runs.back().first != 0xffffffff )
+            runs.back().first++;
+        else
+            runs.push_back( {1, label} );
+    }
+    util::put< std::uint32_t >( file, runs.size(), write_error );
+    for( const auto & run : runs ) {
+        util::put< std::uint32_t >( file, run.first, write_error );
+        util::put< std::uint16_t >( file, run.second, write_error );
+    }
+}
+
+DecisionMap read_decision_map( std::FILE * file ) {
+    util::check_signature( file, magic, version,
+        "Not a decision map.", "Unsupported decision map version.", truncated );
+
+    DecisionMap map;
+    std::size_t size = 1;
+    map.axes.resize( util::get< std::uint32_t >( file, truncated ) );
+    for( auto & axis : map.axes ) {
+        axis.attribute = util::get< std::uint32_t >( file, truncated );
+        axis.points = util::get< std::uint32_t >( file, truncated );
+        axis.first = util::get< double >( file, truncated );
+        axis.step = util::get< double >( file, truncated );
+        size *= axis.points;
+    }
+    map.fixed.resize( util::get< std::uint32_t >( file, truncated ) );
+    for( auto & f : map.fixed ) {
+        f.attribute = util::get< std::uint32_t >( file, truncated );
+        f.value = util::get< double >( file, truncated );
+    }
+    std::size_t categories = util::get< std::uint32_t >( file, truncated );
+    for( std::size_t i = 0; i < categories; i++ )
+        map.categories.push_back( util::get_string( file, truncated ) );
+
+    std::uint8_t encoding = util::get< std::uint8_t >( file, truncated );
+    if( encoding == 0 ) {
+        map.labels.resize( size );
+        util::get_array( file, map.labels.data(), size, truncated );
+    }
+    else if( encoding == 1 ) {
+        std::size_t runs = util::get< std::uint32_t >( file, truncated );
+        for( std::size_t i = 0; i < runs; i++ ) {
+            std::uint32_t length = util::get< std::uint32_t >( file, truncated );
+            std::uint16_t label = util::get< std::uint16_t >( file, truncated );
+            if( length > size - map.labels.size() )
+                throw "Decision map runs exceed the grid.";
+            map.labels.insert( map.labels.end(), length, label );
+        }
+        if( map.labels.size() != size )
+            throw "Decision map runs do not cover the grid.";
+    }
+    else
+        throw "Unknown decision map encoding.";
+
+    for( std::uint16_t label : map.labels )
+        if( label >= map.categories.size() )
+            throw "Decision map label out of range.";
+    return map;
+}
@@ -0,0 +1,119 @@
+#ifndef PR_DECISION_MAP_H
+#define PR_DECISION_MAP_H
+
+/* Decision maps: the category that a classifier chooses
+ * at every point of a regular grid.
+ *
+ * The grid spans some of the attributes of the dataset (the axes);
+ * the other attributes may be held at fixed values,
+ * so that a 2-D map can be a slice of a higher-dimensional classifier.
+ *
+ * Decision maps are written to binary files, in the native byte order:
+ *
+ *      char[4]     "DMAP"
+ *      uint32      version (1)
+ *      uint32      number of axes
+ *          uint32  attribute index
+ *          uint32  number of points
+ *          double  first coordinate
+ *          double  step between points
+ *      uint32      number of fixed attributes
+ *          uint32  attribute index
+ *          double  value
+ *      uint32      number of categories
+ *          uint32  length of the name
+ *          char[]  name (without terminator)
+ *      uint8       encoding: 0 for raw, 1 for run-length
+ *      raw:        uint16 label of each point
+ *      run-length: uint32 number of runs
+ *          uint32  length of the run
+ *          uint16  label of the points of the run
+ *
+ * The points are listed with the last axis varying fastest,
+ * as in GridGenerator; the labels index the list of categories.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+class NearestNeighbor;
+
+struct DecisionMap {
+    /* The coordinates of the attribute along an axis
+     * are first + k * step, for 0 <= k < points.
+     */
+    struct axis {
+        unsigned attribute;
+        unsigned points;
+        double first;
+        double step;
+    };
+    std::vector< axis > axes;
+
+    struct fixed_attribute {
+        unsigned attribute;
+        double value;
+    };
+    std::vector< fixed_attribute > fixed;
+
+    std::vector< std::string > categories;
+    std::vector< std::uint16_t > labels;
+};
+
+/* Classifies every point of a grid over the attributes
+ * that are not in `fixed`, which are held at the given values.
+ *
+ * The grid is built by a GridGenerator, with the given density
+ * (so there are density + 1 points per axis) and expansion factor,
+ * over the free attributes of the classifier's dataset.
+ * The categories are listed in the order they appear in the dataset.
+ *
+ * The points are classified concurrently, in blocks;
+ * see util/parallel.hpp.
+ * Throws if the dataset has more than one category type,
+ * if some fixed attribute does not exist or is repeated,
+ * or if there are more than 65535 categories.
+ */
+DecisionMap evaluate_decision_map(
+    const NearestNeighbor & classifier,
+    const std::vector< DecisionMap::fixed_attribute > & fixed,
+    unsigned density,
+    double expand
+);
+
+/* Classifies every point (xs[x], ys[y]) of the plane of a classifier
+ * whose dataset has two attributes and one category type;
+ * its label is labels[y * xs.size() + x].
+ * The labels index the categories in the order they appear in the dataset,
+ * as in evaluate_decision_map.
+ *
+ * Unless brute_force is set, the plane is subdivided as a quadtree,
+ * and only the points near the boundaries of the regions are classified;
+ * see NearestNeighbor::candidates. xs and ys must be monotone.
+ * With a single neighbor, this is a rasterization of the Voronoi diagram
+ * of the dataset, and no point at all goes through the classifier.
+ * The labels are the same of the brute force,
+ * provided that the distance obeys the triangle inequality,
+ * which is true for every distance of this tree.
+ *
+ * The points are classified concurrently, in tiles;
+ * see util/parallel.hpp.
+ * Throws if the dataset does not have the right shape,
+ * or if there are more than 65535 categories.
+ */
+std::vector< std::uint16_t > classify_plane(
+    const NearestNeighbor & classifier,
+    const std::vector< double > & xs,
+    const std::vector< double > & ys,
+    bool brute_force = false
+);
+
+/* Writes/reads the decision map in the format described above.
+ * Both functions throw on input/output errors,
+ * and read_decision_map also throws on malformed files.
+ */
+void write_decision_map( std::FILE *, const DecisionMap &, bool run_length = true );
+DecisionMap read_decision_map( std::FILE * );
+
+#endif // PR_DECISION_MAP_H
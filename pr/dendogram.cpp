@@ -1,143 +1,416 @@
 #include <algorithm>
+#include <cmath>
 #include <limits>
-#include <list>
+#include <memory>
 #include <sstream>
+#include <unordered_set>
 #include "pr/dendogram.h"
+#include "pr/distance_matrix.h"
 #include "pr/p_norm.h"
+#include "util/stats.h"
+
+namespace {
+    util::stats::counter merges_counter( "dendogram.merges" );
+    util::stats::counter distance_evaluations( "dendogram.distance_evaluations" );
+    util::stats::counter linkage_updates( "dendogram.linkage_updates" );
+    // Rows of the distance matrix scanned for their minimum by generate_dendogram.
+    util::stats::counter row_scans( "dendogram.row_scans" );
+    // Elements pushed to the chain by generate_nn_chain_dendogram.
+    util::stats::counter chain_extensions( "dendogram.chain_extensions" );
+    util::stats::phase initial_distances_phase( "dendogram.initial_distances" );
+    util::stats::phase merging_phase( "dendogram.merging" );
+
+    /* Returns the matrix of the linkage distances between the leaves.
+     *
+     * For the built-in linkages, the distance between two leaves
+     * is just the euclidean distance,
+     * so the matrix is filled in parallel straight from the attributes
+     * instead of calling the LinkageDistanceFunction.
+     */
+    DistanceMatrix initial_distances(
+        const DataSet & dataset,
+        const std::vector< DendogramNode > & leaves,
+        LinkageDistanceFunction distance,
+        const DistanceStorage & storage
+    ) {
+        util::stats::timer timer( initial_distances_phase );
+        std::size_t n = leaves.size();
+        distance_evaluations.add( n * (n - 1) / 2 );
+
+        if( distance == SimpleLinkage || distance == FullLinkage || distance == MeanLinkage ||
+            distance == WardLinkage || distance == CentroidLinkage ||
+            distance == MedianLinkage || distance == WeightedLinkage )
+            return EuclideanDistances( dataset ).matrix( storage );
+
+        DistanceMatrix matrix( n, storage );
+        std::vector< double > row( n );
+        for( std::size_t i = 0; i < n; i++ ) {
+            for( std::size_t j = i + 1; j < n; j++ )
+                row[j - i - 1] = distance( leaves[i], leaves[j] );
+            matrix.set_row( i, row.data() );
+        }
+        return matrix;
+    }
+
+    /* Stores the linkage distances between the node in the slot i,
+     * just merged with the node in the slot j > i, and the active slots k > i.
+     * The LinkageDistanceUpdateFunction receives the old distances
+     * (k, i) and (k, j), which are still in the matrix.
+     *
+     * The distances (i, k) are the row i of the matrix,
+     * and the distances (j, k) for k > j are the row j,
+     * so they are read and written a row at a time.
+     * Only the distances (k, j) for i < k < j are spread over the rows k.
+     *
+     * `row` and `other` must have room for size() - i - 1 values.
+     */
+    void update_row(
+        DistanceMatrix & matrix,
+        const std::vector< DendogramNode > & nodes,
+        const std::vector< bool > & active,
+        LinkageDistanceUpdateFunction update,
+        std::size_t i, std::size_t j,
+        double * row, double * other
+    ) {
+        std::size_t n = matrix.size();
+        matrix.get_row( i, row );
+        matrix.get_row( j, other );
+        for( std::size_t k = i + 1; k < n; k++ ) {
+            if( !active[k] )
+                continue;
+            double d = k < j ? matrix(k, j) : other[k - j - 1];
+            row[k - i - 1] = update( nodes[k], nodes[i], row[k - i - 1], d );
+        }
+        matrix.set_row( i, row );
+    }
+} // anonymous namespace
 
-std::unique_ptr<DendogramNode> generate_dendogram(
+Dendogram generate_dendogram(
     const DataSet & dataset,
     LinkageDistanceFunction distance,
-    LinkageDistanceUpdateFunction update
+    LinkageDistanceUpdateFunction update,
+    const DistanceStorage & storage
 )
 {
-    /* To guarantee the quadratic number of calls,
-     * we will need to annotate each node with the distances required by
-     * the LinkageDistanceUpdateFunction.
-     * This 'node' type will store these annotations.
+    if( distance == SimpleLinkage && update == SimpleLinkageUpdate )
+        return generate_single_linkage_dendogram( dataset, distance );
+    if( update == FullLinkageUpdate || update == MeanLinkageUpdate ||
+        update == WardLinkageUpdate || update == WeightedLinkageUpdate )
+        return generate_nn_chain_dendogram( dataset, distance, update, storage );
+
+    std::size_t n = dataset.size();
+    if( n == 0 )
+        throw "Cannot build a dendogram of an empty dataset.";
+
+    /* Each slot i holds either a cluster (active[i] is true)
+     * or nothing, if the cluster was merged into a lower slot.
+     * When the clusters in the slots i < j are merged,
+     * the new cluster is stored in the slot i.
      *
-     * d_left and d_right will mean, respectively,
-     * the distance to the left and right children
-     * of the node that was just merged.
+     * matrix(i, j) is the linkage distance between the clusters
+     * in the active slots i and j.
      */
-    struct node {
-        std::unique_ptr<DendogramNode> node;
-        double d_left;
-        double d_right;
-        DendogramNode & operator*(){ return *node; }
+    Dendogram dendogram( dataset );
+    std::vector< DendogramNode > nodes;
+    nodes.reserve( n );
+    for( std::size_t i = 0; i < n; i++ )
+        nodes.push_back( dendogram.leaf(i) );
+    std::vector< bool > active( n, true );
+
+    DistanceMatrix matrix = initial_distances( dataset, nodes, distance, storage );
+
+    /* Cache of the minimum of each row of the upper triangle:
+     * neighbor[i] is the smallest active j > i that minimizes matrix(i, j),
+     * or none if there is no such j,
+     * and minimum[i] is matrix(i, neighbor[i]).
+     *
+     * With this cache, finding the closest pair costs O(n)
+     * instead of O(n²), and does not touch the matrix.
+     * Rows whose cached minimum is invalidated by a merge must be rescanned
+     * (sequentially), but this is rare for the usual linkages.
+     */
+    const std::size_t none = -1;
+    std::vector< std::size_t > neighbor( n, none );
+    std::vector< double > minimum( n );
+    std::vector< double > row( n );
+    std::vector< double > other( n );
+
+    auto scan_row = [&]( std::size_t i ) {
+        row_scans.add();
+        neighbor[i] = none;
+        matrix.get_row( i, row.data() );
+        for( std::size_t j = i + 1; j < n; j++ )
+            if( active[j] )
+                if( neighbor[i] == none || row[j - i - 1] < minimum[i] ) {
+                    neighbor[i] = j;
+                    minimum[i] = row[j - i - 1];
+                }
     };
+    for( std::size_t i = 0; i < n; i++ )
+        scan_row( i );
 
-    std::list< node > nodes;
-    typedef std::list< node >::iterator iterator;
-
-    struct distance_data {
-        iterator left;
-        iterator right;
-        double distance;
+    util::stats::timer timer( merging_phase );
+    // Iterate until every node was merged
+    for( std::size_t merges = 1; merges < n; merges++ ) {
+        /* Find the closest pair.
+         * Ties are broken in favor of the smallest pair (i, j),
+         * in lexicographical order.
+         */
+        std::size_t i = none;
+        for( std::size_t k = 0; k < n; k++ )
+            if( active[k] && neighbor[k] != none )
+                if( i == none || minimum[k] < minimum[i] )
+                    i = k;
+        std::size_t j = neighbor[i];
+        double linkage = minimum[i];
 
-        bool has( iterator it ) {
-            return left == it || right == it;
+        // Merge the nodes
+        nodes[i] = dendogram.merge( nodes[i], nodes[j], linkage );
+        active[j] = false;
+        const DendogramNode & merged = nodes[i];
+        merges_counter.add();
+        linkage_updates.add( n - merges - 1 );
+
+        /* Store new distances.
+         * matrix(k, i) and matrix(k, j) still hold the distances
+         * to the children of the merged node,
+         * which is exactly what the LinkageDistanceUpdateFunction needs.
+         *
+         * Only the slots k > i are updated a row at a time (see update_row).
+         * The distances (k, i) and (k, j) for k < i are a column:
+         * one value in each row k, so a merge touches a page per row above i
+         * once the rows are longer than a page.
+         */
+        for( std::size_t k = 0; k < i; k++ ) {
+            if( !active[k] )
+                continue;
+            double d = update( nodes[k], merged, matrix(k, i), matrix(k, j) );
+            matrix.set( k, i, d );
+            /* Read back the stored value,
+             * which may have been rounded to single precision.
+             */
+            d = matrix(k, i);
+
+            // Maintain the cache of the rows above i.
+            if( neighbor[k] == i || neighbor[k] == j )
+                scan_row( k );
+            else if( d < minimum[k] || (d == minimum[k] && i < neighbor[k]) ) {
+                neighbor[k] = i;
+                minimum[k] = d;
+            }
         }
-    };
+        update_row( matrix, nodes, active, update, i, j, row.data(), other.data() );
+        scan_row( i );
 
-    std::list< distance_data > distances;
-    typedef std::list< distance_data >::iterator distance_iterator;
+        // The rows between i and j may have j as their minimum.
+        for( std::size_t k = i + 1; k < j; k++ )
+            if( active[k] && neighbor[k] == j )
+                scan_row( k );
+    }
 
-    // Initialize nodes and distances
-    for( const DataEntry & entry : dataset )
-        nodes.push_back( {std::make_unique<DendogramNode>( &entry ), 0.0, 0.0} );
+    return dendogram;
+}
 
-    for( iterator it = nodes.begin(); it != nodes.end(); ++it ) {
-        iterator jt = it;
-        for( ++jt; jt != nodes.end(); ++jt )
-            distances.push_back( {it, jt, distance(**it, **jt)} );
-    }
+Dendogram generate_single_linkage_dendogram(
+    const DataSet & dataset,
+    LinkageDistanceFunction distance
+)
+{
+    std::size_t n = dataset.size();
+    if( n == 0 )
+        throw "Cannot build a dendogram of an empty dataset.";
+
+    Dendogram dendogram( dataset );
+    std::vector< DendogramNode > nodes;
+    nodes.reserve( n );
+    for( std::size_t i = 0; i < n; i++ )
+        nodes.push_back( dendogram.leaf(i) );
+
+    /* Prim's algorithm.
+     * For each vertex v not yet in the tree,
+     * closest[v] is the distance from v to the tree
+     * and parent[v] is the tree vertex that realizes this distance.
+     */
+    struct edge {
+        std::size_t u, v;
+        double weight;
+    };
+    std::vector< edge > edges;
+    edges.reserve( n - 1 );
 
-    // Iterate until every node was merged
-    while( nodes.size() != 1 ) {
-        distance_data best;
-        best.distance = std::numeric_limits<double>::max();
+    std::vector< bool > in_tree( n, false );
+    std::vector< double > closest( n, std::numeric_limits<double>::infinity() );
+    std::vector< std::size_t > parent( n, 0 );
 
-        // Find the closest pair
-        for( const auto& dist : distances )
-            if( dist.distance < best.distance )
-                best = dist;
+    /* With the built-in linkage, the distances from the last added vertex
+     * are computed directly from the attributes.
+     */
+    std::unique_ptr<EuclideanDistances> kernel;
+    std::vector< double > row;
+    if( distance == SimpleLinkage ) {
+        kernel = std::make_unique<EuclideanDistances>( dataset );
+        row.resize( n );
+    }
 
-        // Merge the nodes
-        nodes.push_back( {
-            std::make_unique<DendogramNode>(
-                std::move(best.left->node), std::move(best.right->node), best.distance
-            ),
-            0.0,
-            0.0
-        } );
-
-        /* Clean 'distance' list.
-         * This is where we do the annotation.
-         * We will eliminate every distance information that contains either
-         * best.left or best.right,
-         * since the DendogramNodes of these two were just merged.
-         *
-         * If the current iterator 'it' points to the distance_data
-         * that has both best.left and best.rigth,
-         * there is nothing to annotate.
-         *
-         * If 'it' points to a distance_data that contains just the best.left,
-         * it means the other iterator points to a node
-         * whose distance to the just-merged node will need to be calculated;
-         * hence, we need to annotate this information.
-         * Specifically, we need to annotate the node that is not best.left
-         * (that's why we create the iterator 'target'),
-         * and since the other node points to best.left,
-         * we need to annotate d_left.
-         *
-         * The situation for best.right is analogous.
-         *
-         * Note that every pair of nodes will appear exactly once in 'distances',
-         * so we will update all the needed information in all nodes.
-         */
-        distance_iterator it = distances.begin();
-        while( it != distances.end() ) {
-            if( it->has( best.left ) && it->has( best.right ) )
-                it = distances.erase( it );
-            else if( it->has( best.left ) ) {
-                iterator target = it->left != best.left ? it->left : it->right;
-                target->d_left = it->distance;
-                it = distances.erase( it );
+    util::stats::timer timer( merging_phase );
+    distance_evaluations.add( n * (n - 1) / 2 );
+    std::size_t last = 0;
+    in_tree[0] = true;
+    for( std::size_t added = 1; added < n; added++ ) {
+        if( kernel )
+            kernel->distances( last, 0, n, row.data() );
+
+        std::size_t next = n;
+        for( std::size_t v = 0; v < n; v++ ) {
+            if( in_tree[v] )
+                continue;
+            double d = kernel ? row[v] : distance( nodes[last], nodes[v] );
+            if( d < closest[v] ) {
+                closest[v] = d;
+                parent[v] = last;
             }
-            else if( it->has( best.right ) ) {
-                iterator target = it->left != best.right ? it->left : it->right;
-                target->d_right = it->distance;
-                it = distances.erase( it );
-            }
-            else
-                ++it;
+            if( next == n || closest[v] < closest[next] )
+                next = v;
         }
+        in_tree[next] = true;
+        edges.push_back( {parent[next], next, closest[next]} );
+        last = next;
+    }
 
-        /* Remove the old nodes.
-         * We must not erase best.left and best.right before cleaning 'distances'
-         * because we compare iterators for equality in that loop,
-         * so they must've had been valid until now.
-         */
-        nodes.erase( best.left );
-        nodes.erase( best.right );
+    /* Kruskal-like pass over the tree edges:
+     * merging the components in increasing edge weight
+     * gives the single linkage dendogram.
+     * The union-find forest keeps, in the representative of each component,
+     * the dendogram node of that component.
+     */
+    std::stable_sort( edges.begin(), edges.end(),
+        []( const edge & a, const edge & b ) {
+            return a.weight < b.weight;
+        }
+    );
+
+    std::vector< std::size_t > representative( n );
+    for( std::size_t i = 0; i < n; i++ )
+        representative[i] = i;
+    auto find = [&]( std::size_t i ) {
+        while( representative[i] != i ) {
+            representative[i] = representative[representative[i]];
+            i = representative[i];
+        }
+        return i;
+    };
 
-        /* Store new distances
-         * We must take care to not measure the distance
-         * between the last node and itself.
+    for( const edge & e : edges ) {
+        std::size_t a = find( e.u );
+        std::size_t b = find( e.v );
+        if( a > b )
+            std::swap( a, b );
+        nodes[a] = dendogram.merge( nodes[a], nodes[b], e.weight );
+        representative[b] = a;
+    }
+    merges_counter.add( edges.size() );
+
+    return dendogram;
+}
+
+Dendogram generate_nn_chain_dendogram(
+    const DataSet & dataset,
+    LinkageDistanceFunction distance,
+    LinkageDistanceUpdateFunction update,
+    const DistanceStorage & storage
+)
+{
+    std::size_t n = dataset.size();
+    if( n == 0 )
+        throw "Cannot build a dendogram of an empty dataset.";
+
+    // Same slot layout of generate_dendogram.
+    Dendogram dendogram( dataset );
+    std::vector< DendogramNode > nodes;
+    nodes.reserve( n );
+    for( std::size_t i = 0; i < n; i++ )
+        nodes.push_back( dendogram.leaf(i) );
+    std::vector< bool > active( n, true );
+
+    DistanceMatrix matrix = initial_distances( dataset, nodes, distance, storage );
+
+    /* chain[k+1] is the nearest neighbor of chain[k].
+     * For a reducible linkage, the chain stays valid after a merge
+     * of its last two elements, so it is never rebuilt from scratch.
+     */
+    std::vector< std::size_t > chain;
+    chain.reserve( n );
+    std::vector< double > row( n );
+    std::vector< double > other( n );
+
+    util::stats::timer timer( merging_phase );
+    for( std::size_t merges = 1; merges < n; merges++ ) {
+        if( chain.empty() )
+            for( std::size_t k = 0; k < n; k++ )
+                if( active[k] ) {
+                    chain.push_back( k );
+                    break;
+                }
+
+        /* Extend the chain until its last two elements
+         * are the nearest neighbor of each other.
+         * In case of ties, the previous element of the chain is preferred,
+         * so the chain never cycles.
          */
-        iterator jt = nodes.begin();
-        iterator end = nodes.end();
-        iterator target = --end;
-        for( ; jt != end; ++jt )
-            distances.push_back( {
-                jt,
-                target,
-                update(**jt, **target, jt->d_left, jt->d_right)
-            } );
+        std::size_t a, b;
+        while( true ) {
+            a = chain.back();
+            std::size_t previous = chain.size() >= 2 ? chain[chain.size() - 2] : n;
+            b = previous;
+            double closest = b == n ? 0 : matrix(a, b);
+            /* The distances (k, a) for k < a are a column of the matrix,
+             * one value in each row k,
+             * but the distances (a, k) for k > a are contiguous,
+             * so the latter are read at once.
+             */
+            for( std::size_t k = 0; k < a; k++ )
+                if( active[k] ) {
+                    double d = matrix(k, a);
+                    if( b == n || d < closest ) {
+                        b = k;
+                        closest = d;
+                    }
+                }
+            matrix.get_row( a, row.data() );
+            for( std::size_t k = a + 1; k < n; k++ )
+                if( active[k] ) {
+                    double d = row[k - a - 1];
+                    if( b == n || d < closest ) {
+                        b = k;
+                        closest = d;
+                    }
+                }
+            if( b == previous )
+                break;
+            chain.push_back( b );
+            chain_extensions.add();
+        }
+        chain.pop_back();
+        chain.pop_back();
+
+        std::size_t i = std::min( a, b );
+        std::size_t j = std::max( a, b );
+        nodes[i] = dendogram.merge( nodes[i], nodes[j], matrix(i, j) );
+        active[j] = false;
+        merges_counter.add();
+        linkage_updates.add( n - merges - 1 );
+
+        /* As in generate_dendogram, only the slots k > i
+         * are updated a row at a time;
+         * the slots k < i are a column of the matrix.
+         */
+        for( std::size_t k = 0; k < i; k++ )
+            if( active[k] )
+                matrix.set( k, i, update( nodes[k], nodes[i], matrix(k, i), matrix(k, j) ) );
+        update_row( matrix, nodes, active, update, i, j, row.data(), other.data() );
     }
 
-    return std::move( nodes.front().node );
+    return dendogram;
 }
 
 double SimpleLinkage( const DendogramNode & a, const DendogramNode & b ) {
@@ -194,6 +467,235 @@ double MeanLinkageUpdate(
     return (d1 * b.left().size() + d2 * b.right().size()) / b.size();
 }
 
+namespace {
+    /* Coefficients of the Lance-Williams formula for each linkage.
+     * The clusters of sizes ni and nj were merged,
+     * and nk is the size of the cluster whose distance is being updated.
+     */
+    struct lance_williams_coefficients {
+        double alpha_i;
+        double alpha_j;
+        double beta;
+        double gamma;
+        // Whether the formula applies to the squared distances.
+        bool squared;
+    };
+
+    enum class lance_williams_linkage { ward, centroid, median, weighted };
+
+    lance_williams_coefficients coefficients(
+        lance_williams_linkage linkage,
+        double ni,
+        double nj,
+        double nk
+    ) {
+        switch( linkage ) {
+            case lance_williams_linkage::ward:
+                return { (ni + nk) / (ni + nj + nk), (nj + nk) / (ni + nj + nk),
+                    -nk / (ni + nj + nk), 0, true };
+            case lance_williams_linkage::centroid:
+                return { ni / (ni + nj), nj / (ni + nj),
+                    -ni * nj / ((ni + nj) * (ni + nj)), 0, true };
+            case lance_williams_linkage::median:
+                return { 0.5, 0.5, -0.25, 0, true };
+            case lance_williams_linkage::weighted:
+                return { 0.5, 0.5, 0, 0, false };
+        }
+        throw "Unknown Lance-Williams linkage.";
+    }
+
+    /* Distance between the node k and the merged node,
+     * given the distances d1 and d2 from k to the children of merged.
+     * The distance between the children is the linkage distance of merged.
+     */
+    double lance_williams_update(
+        lance_williams_linkage linkage,
+        const DendogramNode & k,
+        const DendogramNode & merged,
+        double d1,
+        double d2
+    ) {
+        auto c = coefficients( linkage,
+            merged.left().size(), merged.right().size(), k.size() );
+        double dij = merged.linkage_distance();
+        if( c.squared ) {
+            d1 *= d1;
+            d2 *= d2;
+            dij *= dij;
+        }
+        double d = c.alpha_i * d1 + c.alpha_j * d2 + c.beta * dij
+            + c.gamma * std::fabs( d1 - d2 );
+        if( !c.squared )
+            return d;
+        // Rounding may give slightly negative values for coincident centroids.
+        return std::sqrt( std::max( d, 0.0 ) );
+    }
+
+    /* Weighted center of the leaves of the node.
+     * If halving is false, every leaf has the same weight (the centroid);
+     * otherwise, every structural node gives the same weight to both children,
+     * so a leaf at depth h below the node has weight 2^-h.
+     */
+    std::vector< double > center( const DendogramNode & node, bool halving ) {
+        std::vector< double > result( node.begin()->attribute_count(), 0.0 );
+        std::vector< std::pair< DendogramNode, double > > stack{ {node, 1.0} };
+        while( !stack.empty() ) {
+            auto top = stack.back();
+            stack.pop_back();
+            if( top.first.structural() && halving ) {
+                stack.push_back( {top.first.right(), top.second / 2} );
+                stack.push_back( {top.first.left(), top.second / 2} );
+                continue;
+            }
+            for( const DataEntry & entry : top.first )
+                for( std::size_t i = 0; i < result.size(); i++ )
+                    result[i] += top.second * entry.attribute(i) / top.first.size();
+        }
+        return result;
+    }
+
+    double center_distance( const DendogramNode & a, const DendogramNode & b, bool halving ) {
+        std::vector< double > ca = center( a, halving );
+        std::vector< double > cb = center( b, halving );
+        double sum = 0;
+        for( std::size_t i = 0; i < ca.size(); i++ )
+            sum = std::fma( ca[i] - cb[i], ca[i] - cb[i], sum );
+        return std::sqrt( sum );
+    }
+} // anonymous namespace
+
+double WardLinkage( const DendogramNode & a, const DendogramNode & b ) {
+    double na = a.size(), nb = b.size();
+    return std::sqrt( 2 * na * nb / (na + nb) ) * center_distance( a, b, false );
+}
+double WardLinkageUpdate(
+    const DendogramNode & a,
+    const DendogramNode & b,
+    double d1,
+    double d2
+) {
+    return lance_williams_update( lance_williams_linkage::ward, a, b, d1, d2 );
+}
+
+double CentroidLinkage( const DendogramNode & a, const DendogramNode & b ) {
+    return center_distance( a, b, false );
+}
+double CentroidLinkageUpdate(
+    const DendogramNode & a,
+    const DendogramNode & b,
+    double d1,
+    double d2
+) {
+    return lance_williams_update( lance_williams_linkage::centroid, a, b, d1, d2 );
+}
+
+double MedianLinkage( const DendogramNode & a, const DendogramNode & b ) {
+    return center_distance( a, b, true );
+}
+double MedianLinkageUpdate(
+    const DendogramNode & a,
+    const DendogramNode & b,
+    double d1,
+    double d2
+) {
+    return lance_williams_update( lance_williams_linkage::median, a, b, d1, d2 );
+}
+
+double WeightedLinkage( const DendogramNode & a, const DendogramNode & b ) {
+    /* Each node weights its children equally,
+     * so this is the average of the distances to the children of b
+     * (or of a, if b is a leaf).
+     */
+    if( b.structural() )
+        return (WeightedLinkage( a, b.left() ) + WeightedLinkage( a, b.right() )) / 2;
+    if( a.structural() )
+        return (WeightedLinkage( a.left(), b ) + WeightedLinkage( a.right(), b )) / 2;
+    return EuclideanDistance(0.0)( a.data(), b.data() );
+}
+double WeightedLinkageUpdate(
+    const DendogramNode & a,
+    const DendogramNode & b,
+    double d1,
+    double d2
+) {
+    return lance_williams_update( lance_williams_linkage::weighted, a, b, d1, d2 );
+}
+
+const LinkageMethod * find_linkage_method( const std::string & name ) {
+    static const LinkageMethod methods[] = {
+        { "simple", SimpleLinkage, SimpleLinkageUpdate },
+        { "full", FullLinkage, FullLinkageUpdate },
+        { "mean", MeanLinkage, MeanLinkageUpdate },
+        { "ward", WardLinkage, WardLinkageUpdate },
+        { "centroid", CentroidLinkage, CentroidLinkageUpdate },
+        { "median", MedianLinkage, MedianLinkageUpdate },
+        { "weighted", WeightedLinkage, WeightedLinkageUpdate },
+    };
+    for( const LinkageMethod & method : methods )
+        if( name == method.name )
+            return &method;
+    return nullptr;
+}
+
+namespace {
+    /* Top nodes of the classes when the dendogram is divided
+     * in successively more classes.
+     *
+     * The nodes are kept in a max-heap keyed on linkage distance,
+     * so each split takes logarithmic time.
+     * Ties are broken in favor of structural nodes,
+     * and then of the nodes created later (that is, the higher ids),
+     * so a leaf is never split while there is a structural node
+     * and the order of the splits is deterministic.
+     */
+    class class_splitter {
+        static bool lower_priority( const DendogramNode & a, const DendogramNode & b ) {
+            if( a.linkage_distance() != b.linkage_distance() )
+                return a.linkage_distance() < b.linkage_distance();
+            if( a.structural() != b.structural() )
+                return b.structural();
+            return a.id() < b.id();
+        }
+
+        std::vector< DendogramNode > heap;
+
+    public:
+        explicit class_splitter( const DendogramNode & root ) :
+            heap{ root }
+        {}
+
+        /* Splits the class with the highest linkage distance
+         * and returns that linkage distance.
+         * The caller must ensure there is some structural node left.
+         */
+        double split() {
+            std::pop_heap( heap.begin(), heap.end(), lower_priority );
+            DendogramNode node = heap.back();
+            heap.back() = node.left();
+            std::push_heap( heap.begin(), heap.end(), lower_priority );
+            heap.push_back( node.right() );
+            std::push_heap( heap.begin(), heap.end(), lower_priority );
+            return node.linkage_distance();
+        }
+
+        const std::vector< DendogramNode > & classes() const {
+            return heap;
+        }
+    };
+} // anonymous namespace
+
+std::vector< double > split_linkage_profile( const DendogramNode & root, int count ) {
+    if( count < 0 || count >= (int) root.size() )
+        throw "Cannot split the dendogram that many times.";
+
+    class_splitter splitter( root );
+    std::vector< double > profile;
+    profile.reserve( count );
+    for( int i = 0; i < count; i++ )
+        profile.push_back( splitter.split() );
+    return profile;
+}
+
 dendogram_classification_data classify_dendogram(
     const DendogramNode & root,
     int min_class,
@@ -205,119 +707,89 @@ dendogram_classification_data classify_dendogram(
         throw "max_class is greater than the number of leaves in the dendogram.";
     if( min_class > max_class )
         throw "min_class > max_class.";
+    if( min_class < 1 )
+        throw "min_class must be positive.";
 
-    std::vector< const DendogramNode * > classes;
-    classes.reserve( max_class );
-    classes.push_back( &root );
-
-    /* We will iterate through every possible splitting of the dendogram
-     * in k classes.
-     * The list 'classes' will hold the list of nodes
-     * that are at the top of its classes
-     * when we divide the dendogram in $k$ different classes.
+    /* We need the linkage distance of every split up to max_class classes,
+     * and of the next split, if there is any.
      *
-     * Note that positional information about classes is irrelevant,
-     * so we may use a std::vector instead of a std::list.
+     * For j >= 1, split_linkage(j) is the highest linkage distance
+     * between the top nodes of the j classes;
+     * that is, the linkage distance of the j-th split,
+     * counting the split of the root as the first one.
+     * For convenience, split_linkage(0) is also the linkage distance of the root.
      */
-
-    /* Splits the vector 'classes' in the node with highest linkage distance.
-     * Returns the second-highest linkage distance in that vector.
-     */
-    auto split_classes = [&](){
-        double highest_linkage_distance = 0.0;
-        double second_highest_linkage_distance = 0.0;
-        unsigned index_of_highest = 0;
-
-        // First, find the correct index
-        for( int i = 0; i < classes.size(); i++ ) {
-            if( classes[i]->linkage_distance() > highest_linkage_distance ) {
-                second_highest_linkage_distance = highest_linkage_distance;
-                highest_linkage_distance = classes[i]->linkage_distance();
-                index_of_highest = i;
-            }
-            if( classes[i]->linkage_distance() > second_highest_linkage_distance )
-                second_highest_linkage_distance = classes[i]->linkage_distance();
-        }
-
-        // Now, split!
-        const DendogramNode * old_class = classes[index_of_highest];
-        classes[index_of_highest] = &old_class->left();
-        classes.push_back( &old_class->right() );
-
-        if( old_class->left().linkage_distance() > second_highest_linkage_distance )
-            second_highest_linkage_distance = old_class->left().linkage_distance();
-        if( old_class->right().linkage_distance() > second_highest_linkage_distance )
-            second_highest_linkage_distance = old_class->right().linkage_distance();
-
-        return second_highest_linkage_distance;
+    bool has_next_split = max_class < root.size();
+    std::vector< double > profile = split_linkage_profile(
+        root, has_next_split ? max_class : max_class - 1
+    );
+    auto split_linkage = [&]( int j ) {
+        return j == 0 ? root.linkage_distance() : profile[j - 1];
     };
 
-    // Highest linkage distante when we last divided the 'classes' vector.
-    double current_linkage_distance = root.linkage_distance();
-    // Previous value of current_linkage_distance
-    double previous_linkage_distance = root.linkage_distance();
-
-    // First, we will add min_class classes to 'classes'.
-    for( int i = 1; i < min_class; i++ ) {
-        previous_linkage_distance = current_linkage_distance;
-        current_linkage_distance = split_classes();
-    }
-
     // dendogram_classification_data attributes.
-    const double linkage_min_class = current_linkage_distance;
+    const double linkage_min_class = split_linkage( min_class - 1 );
+    const double linkage_max_class = split_linkage( max_class - 1 );
 
     /* upper_limit and lower_limit are exactly these if min_class == max_class.
      */
-    double linkage_upper_limit = current_linkage_distance;
-    double linkage_lower_limit = current_linkage_distance;
+    double linkage_upper_limit = linkage_min_class;
+    double linkage_lower_limit = linkage_min_class;
 
     /* Now, we will iterate for every k in the range [min_class, max_class]
      * and choose the one that maximizes the linkage delta.
      *
-     * linkage delta is the difference between
-     * the linkage distance of the class we just split
-     * and the linkage distance of the class we will split next.
+     * With k classes, the linkage delta is the difference between
+     * the linkage distance of the split that created the k-th class
+     * and the linkage distance of the next split.
      *
-     * It starts as zero since the current upper and lower limits are zero.
-     *
-     * We must take care of one detail: the difference
-     * previous_linkage_distance - current_linkage_distance
-     * refers to the last split, not to the current split.
-     * Therefore, we must store the last_split
-     * and store it in best_split if it would increase the linkage_delta.
+     * It starts as zero since the current upper and lower limits are equal.
      */
-    std::vector< const DendogramNode * > best_split = classes;
-    std::vector< const DendogramNode * > last_split = classes;
+    int best_k = min_class;
     double best_linkage_delta = 0.0;
-
-    int k; // number of classes
     for( int k = min_class; k < max_class; k++ ) {
-        previous_linkage_distance = current_linkage_distance;
-        last_split = classes;
-        current_linkage_distance = split_classes();
-        if( previous_linkage_distance - current_linkage_distance > best_linkage_delta ) {
-            best_linkage_delta = previous_linkage_distance - current_linkage_distance;
-            best_split = last_split;
-            linkage_upper_limit = previous_linkage_distance;
-            linkage_lower_limit = current_linkage_distance;
+        double delta = split_linkage(k - 1) - split_linkage(k);
+        if( delta > best_linkage_delta ) {
+            best_linkage_delta = delta;
+            best_k = k;
+            linkage_upper_limit = split_linkage(k - 1);
+            linkage_lower_limit = split_linkage(k);
         }
     }
-    /* Note that with this algorithm we will never have max_class classes.
-     * So, if max_class < root.size(), we should do another iteration,
+    /* The loop above never chooses max_class classes.
+     * So, if max_class < root.size(), we should consider it too,
      * but taking care not to spoil the ordering contitions
      * on the returned dendogram_classification_data.
      */
-    if( max_class < root.size() ) {
-        last_split = classes;
-        double last_linkage_distance = split_classes();
-        if( current_linkage_distance - last_linkage_distance > best_linkage_delta ) {
-            best_split = last_split;
-            linkage_lower_limit = linkage_upper_limit = current_linkage_distance;
-        }
+    if( has_next_split &&
+        split_linkage(max_class - 1) - split_linkage(max_class) > best_linkage_delta )
+    {
+        best_k = max_class;
+        linkage_lower_limit = linkage_upper_limit = split_linkage( max_class - 1 );
     }
 
-    // dendogram_classification_data attribute.
-    const double linkage_max_class = current_linkage_distance;
+    /* Redo the splits up to the chosen number of classes,
+     * and list the classes from left to right in the dendogram.
+     */
+    class_splitter splitter( root );
+    for( int k = 1; k < best_k; k++ )
+        splitter.split();
+    std::unordered_set< std::size_t > class_ids;
+    for( const DendogramNode & node : splitter.classes() )
+        class_ids.insert( node.id() );
+
+    std::vector< DendogramNode > best_split;
+    std::vector< DendogramNode > stack{ root };
+    while( !stack.empty() ) {
+        DendogramNode node = stack.back();
+        stack.pop_back();
+        if( class_ids.count( node.id() ) )
+            best_split.push_back( node );
+        else {
+            stack.push_back( node.right() );
+            stack.push_back( node.left() );
+        }
+    }
 
     // Finally, construct and return the dataset.
     std::vector< std::string > attribute_names;
@@ -328,10 +800,10 @@ dendogram_classification_data classify_dendogram(
 
     int class_number = 1;
     std::stringstream class_name;
-    for( const DendogramNode * ptr : best_split ) {
+    for( const DendogramNode & node : best_split ) {
         class_name.str( "" );
         class_name << "C" << class_number++;
-        for( const auto& entry : *ptr )
+        for( const auto& entry : node )
             entries.emplace_back(
                 std::vector<double>( entry.attributes() ),
                 std::vector<std::string>{ class_name.str() },
@@ -352,3 +824,83 @@ dendogram_classification_data classify_dendogram(
         linkage_max_class,
     };
 }
+
+namespace {
+    /* Labels the leaves of the dendogram with the index of its class,
+     * numbering the classes from left to right.
+     */
+    std::vector< int > class_labels(
+        const Dendogram & dendogram,
+        std::vector< DendogramNode > classes
+    ) {
+        std::sort( classes.begin(), classes.end(),
+            []( const DendogramNode & a, const DendogramNode & b ) {
+                return a.leaf_offset() < b.leaf_offset();
+            }
+        );
+        const std::vector< std::size_t > & order = dendogram.leaf_order();
+        std::vector< int > labels( dendogram.leaf_count() );
+        for( int c = 0; c < classes.size(); c++ ) {
+            std::size_t begin = classes[c].leaf_offset();
+            for( std::size_t i = begin; i < begin + classes[c].size(); i++ )
+                labels[order[i]] = c;
+        }
+        return labels;
+    }
+} // anonymous namespace
+
+std::vector< std::vector< int > > cut_dendogram_classes(
+    const Dendogram & dendogram,
+    const std::vector< int > & class_counts
+) {
+    DendogramNode root = dendogram.root();
+    for( int k : class_counts )
+        if( k < 1 || k > (int) root.size() )
+            throw "Invalid number of classes for the dendogram cut.";
+
+    // Do the cuts in increasing number of classes, reusing the splits.
+    std::vector< std::size_t > order( class_counts.size() );
+    for( std::size_t i = 0; i < order.size(); i++ )
+        order[i] = i;
+    std::sort( order.begin(), order.end(), [&]( std::size_t a, std::size_t b ) {
+        return class_counts[a] < class_counts[b];
+    });
+
+    std::vector< std::vector< int > > labels( class_counts.size() );
+    class_splitter splitter( root );
+    int classes = 1;
+    for( std::size_t i : order ) {
+        for( ; classes < class_counts[i]; classes++ )
+            splitter.split();
+        labels[i] = class_labels( dendogram, splitter.classes() );
+    }
+    return labels;
+}
+
+std::vector< std::vector< int > > cut_dendogram_thresholds(
+    const Dendogram & dendogram,
+    const std::vector< double > & thresholds
+) {
+    DendogramNode root = dendogram.root();
+    std::vector< double > profile = split_linkage_profile( root, root.size() - 1 );
+
+    /* We stop splitting at the first split whose linkage distance
+     * is not above the threshold.
+     * The linkage distances of the splits only decrease for monotone linkages,
+     * so we search the running minimum of the profile instead.
+     */
+    std::vector< double > running_minimum( profile.size() );
+    for( std::size_t j = 0; j < profile.size(); j++ )
+        running_minimum[j] = j == 0 ? profile[0] : std::min( running_minimum[j-1], profile[j] );
+
+    std::vector< int > class_counts;
+    class_counts.reserve( thresholds.size() );
+    for( double threshold : thresholds ) {
+        auto first = std::lower_bound(
+            running_minimum.begin(), running_minimum.end(), threshold,
+            []( double linkage, double threshold ) { return linkage > threshold; }
+        );
+        class_counts.push_back( 1 + (first - running_minimum.begin()) );
+    }
+    return cut_dendogram_classes( dendogram, class_counts );
+}
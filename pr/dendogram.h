@@ -3,9 +3,10 @@
 
 // Utilities to build a dendogram from a DataSet.
 
-#include <memory>
+#include <string>
 #include "pr/data_set.h"
 #include "pr/dendogram_node.h"
+#include "pr/distance_matrix.h"
 
 /* Type that represents a function that takes a pair of DendogramNodes
  * and return their relative distance.
@@ -28,17 +29,46 @@ using LinkageDistanceUpdateFunction =
     double( const DendogramNode &, const DendogramNode &, double, double );
 
 /* Builds a dendogram.
- * The nodes will point to the values inside the dataset.
+ * The leaves will point to the values inside the dataset,
+ * in the same order; that is, the leaf i is the i-th entry of the dataset.
  *
  * It will make a quadratic number of calls to the LinkageDistanceFunction,
  * with trees with a single node,
  * and a quadratic number of calls to LinkageDistanceUpdateFunction,
  * with varied tree sizes.
+ * (For the linkages declared below, the distance between
+ * single nodes is the euclidean distance, so the LinkageDistanceFunction
+ * is not called at all; the distances are computed in parallel
+ * by EuclideanDistances instead.)
+ *
+ * The distances are kept in a DistanceMatrix (n(n-1)/2 doubles),
+ * together with the minimum of each of its rows,
+ * so the closest pair is found in linear time.
+ * If several pairs are equally close,
+ * the pair that comes first in the dataset order is merged first.
+ *
+ * If the functions are SimpleLinkage and SimpleLinkageUpdate,
+ * this function delegates to generate_single_linkage_dendogram;
+ * if the update function is FullLinkageUpdate, MeanLinkageUpdate,
+ * WardLinkageUpdate or WeightedLinkageUpdate,
+ * it delegates to generate_nn_chain_dendogram.
+ *
+ * The DistanceStorage chooses how the distance matrix is stored;
+ * for very large datasets, it may be kept in single precision
+ * and/or in a memory-mapped file.
+ * (Note that single precision may change the order of close merges.)
+ * Each merge reads and writes a column of the matrix, one value per row,
+ * so a mapped matrix much larger than the memory is paged in
+ * over and over.
+ * The single linkage algorithm needs no matrix, so it ignores the storage.
+ *
+ * Throws if the dataset is empty.
  */
-std::unique_ptr<DendogramNode> generate_dendogram(
+Dendogram generate_dendogram(
     const DataSet &,
     LinkageDistanceFunction,
-    LinkageDistanceUpdateFunction
+    LinkageDistanceUpdateFunction,
+    const DistanceStorage & = {}
 );
 
 /* Simple linkage: the distance is the smallest distance
@@ -55,6 +85,109 @@ LinkageDistanceUpdateFunction FullLinkageUpdate;
 LinkageDistanceFunction MeanLinkage;
 LinkageDistanceUpdateFunction MeanLinkageUpdate;
 
+/* The following linkages are updated by the Lance-Williams formula
+ *  d(k, i+j) = ai d(k, i) + aj d(k, j) + b d(i, j) + c |d(k, i) - d(k, j)|,
+ * where i+j is the merge of the clusters i and j.
+ * The coefficients ai, aj, b and c depend only on the linkage
+ * and on the sizes of the clusters i, j and k,
+ * so each update takes constant time.
+ * (The three linkages above are also particular cases of this formula.)
+ *
+ * For Ward, centroid and median linkages, the formula holds
+ * for the squared distances; the update functions square the distances
+ * and take the square root back, so that every linkage distance
+ * is in the same scale of the euclidean distance.
+ *
+ * Centroid and median linkages are not monotone:
+ * a node may have a smaller linkage distance than its children.
+ */
+
+/* Ward linkage: sqrt(2 na nb / (na + nb)) times the distance
+ * between the centroids of the nodes, where na and nb are their sizes.
+ * Merging the closest pair gives the least increase
+ * in the total within-cluster variance.
+ */
+LinkageDistanceFunction WardLinkage;
+LinkageDistanceUpdateFunction WardLinkageUpdate;
+
+// Centroid linkage (UPGMC): distance between the centroids.
+LinkageDistanceFunction CentroidLinkage;
+LinkageDistanceUpdateFunction CentroidLinkageUpdate;
+
+/* Median linkage (WPGMC): distance between the centers of the nodes,
+ * where the center of a structural node is the midpoint of the centers
+ * of its children, regardless of their sizes.
+ */
+LinkageDistanceFunction MedianLinkage;
+LinkageDistanceUpdateFunction MedianLinkageUpdate;
+
+/* Weighted linkage (WPGMA): the distance to a structural node
+ * is the average of the distances to its children,
+ * regardless of their sizes.
+ */
+LinkageDistanceFunction WeightedLinkage;
+LinkageDistanceUpdateFunction WeightedLinkageUpdate;
+
+/* A pair of linkage functions, identified by name.
+ */
+struct LinkageMethod {
+    const char * name;
+    LinkageDistanceFunction * distance;
+    LinkageDistanceUpdateFunction * update;
+};
+
+/* Finds the linkage functions with the given name:
+ * "simple", "full", "mean", "ward", "centroid", "median" or "weighted".
+ * Returns nullptr if there is no such linkage.
+ */
+const LinkageMethod * find_linkage_method( const std::string & name );
+
+/* Builds the single linkage dendogram of the dataset
+ * from its minimum spanning tree, which is computed by Prim's algorithm
+ * over the implicit complete graph.
+ *
+ * The LinkageDistanceFunction is only called with trees with a single node,
+ * and defines the weight of the edges of the graph.
+ * Takes O(n²) time and O(n) memory, besides the dendogram itself.
+ *
+ * The single linkage dendogram is the same
+ * regardless of the algorithm,
+ * except for the order of merges with the same linkage distance.
+ *
+ * Throws if the dataset is empty.
+ */
+Dendogram generate_single_linkage_dendogram(
+    const DataSet &,
+    LinkageDistanceFunction = SimpleLinkage
+);
+
+/* Builds the dendogram with the nearest neighbor chain algorithm.
+ *
+ * The algorithm follows a chain of nearest neighbors
+ * until it finds two clusters that are the nearest neighbor of each other,
+ * and merges them. This only gives the correct dendogram
+ * if the linkage is reducible: merging two clusters never makes
+ * the new cluster closer to a third one than both of the merged clusters were.
+ * This is true for the full, mean, Ward and weighted linkages,
+ * but not for the centroid and median linkages.
+ *
+ * Uses a DistanceMatrix, like generate_dendogram,
+ * but it needs no global search for the closest pair;
+ * the whole construction takes O(n²) time.
+ * The number of calls to the linkage functions is the same of generate_dendogram.
+ *
+ * The merges are the same of generate_dendogram,
+ * except for the order of merges with the same linkage distance.
+ *
+ * Throws if the dataset is empty.
+ */
+Dendogram generate_nn_chain_dendogram(
+    const DataSet &,
+    LinkageDistanceFunction,
+    LinkageDistanceUpdateFunction,
+    const DistanceStorage & = {}
+);
+
 /* Given two parameters min_class and max_class,
  * this function will find the "optimum cut" k (min_class <= k <= max_class)
  * and divide the dendogram in k different classes.
@@ -81,8 +214,8 @@ LinkageDistanceUpdateFunction MeanLinkageUpdate;
  *  linkage_upper_limit
  *      Maximum linkage distance of top nodes with $k-1$ classes.
  *
- *  Note that linkage_min_class <= linkage_upper_limit <=
- *      linkage_lower_limit <= linkage_max_class.
+ *  Note that linkage_min_class >= linkage_upper_limit >=
+ *      linkage_lower_limit >= linkage_max_class.
  *
  * (We will extract attribute names from the dataset 'base'.)
  *
@@ -93,6 +226,14 @@ LinkageDistanceUpdateFunction MeanLinkageUpdate;
  *
  * (Note that we will never put everything in a single class
  * unless the max_class parameter forces us to.)
+ *
+ * The classes are numbered from left to right in the dendogram.
+ * The splits are computed only once, by split_linkage_profile,
+ * so this function takes O(max_class log max_class) time
+ * besides the construction of the dataset.
+ *
+ * Throws if min_class < 1, min_class > max_class,
+ * or max_class is greater than the number of leaves.
  */
 struct dendogram_classification_data {
     DataSet classified_dataset;
@@ -110,4 +251,50 @@ dendogram_classification_data classify_dendogram(
     const DataSet& base
 );
 
+/* Divides the dendogram in successively more classes,
+ * always splitting the class whose top node has the highest linkage distance,
+ * and returns the linkage distances of the first `count` splits.
+ *
+ * That is, the element k-1 is the highest linkage distance
+ * between the top nodes of the k classes,
+ * and the difference between the elements k-2 and k-1
+ * is the linkage delta that classify_dendogram maximizes.
+ *
+ * The top nodes are kept in a max-heap keyed on linkage distance,
+ * so this takes O(count log count) time.
+ *
+ * Throws if count is negative or not smaller than the number of leaves.
+ */
+std::vector< double > split_linkage_profile( const DendogramNode &, int count );
+
+/* Cuts the dendogram in flat classes, once for each element of the vector,
+ * and returns a label array for each cut:
+ * the element i of a label array is the class (from 0 to k-1)
+ * of the i-th leaf of the dendogram, that is, of the i-th entry of the dataset.
+ * The classes are numbered from left to right in the dendogram.
+ *
+ * cut_dendogram_classes divides the dendogram in the given numbers of classes,
+ * splitting the classes in the same order of classify_dendogram.
+ *
+ * cut_dendogram_thresholds splits the classes while some of them
+ * has a linkage distance above the threshold.
+ * (For monotone linkages, every class is thus a maximal subtree
+ * whose linkage distance is not above the threshold.)
+ *
+ * The splits are computed only once for all the cuts,
+ * and each cut costs a single pass over the leaves;
+ * nothing is copied from the dataset.
+ *
+ * Throws if the dendogram is not complete,
+ * or if some number of classes is not between 1 and the number of leaves.
+ */
+std::vector< std::vector< int > > cut_dendogram_classes(
+    const Dendogram &,
+    const std::vector< int > & class_counts
+);
+std::vector< std::vector< int > > cut_dendogram_thresholds(
+    const Dendogram &,
+    const std::vector< double > & thresholds
+);
+
 #endif // DENDOGRAM_H
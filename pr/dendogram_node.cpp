@@ -2,9 +2,12 @@
 #include <utility>
 #include "dendogram_node.h"
 #include "pr/data_entry.h"
+#include "pr/data_set.h"
+
+constexpr unsigned Dendogram::none;
 
 DendogramIterator::reference DendogramIterator::operator*() const {
-    return _node->data();
+    return *_dendogram->entries[_leaf];
 }
 
 DendogramIterator::pointer DendogramIterator::operator->() const {
@@ -12,117 +15,205 @@ DendogramIterator::pointer DendogramIterator::operator->() const {
 }
 
 DendogramIterator & DendogramIterator::operator++() {
-    /* Two phases: first, go up, while we are at the right node;
-     * then, after we reach the first node by the left,
-     * go to the right and descend by the left.
+    /* The leaves of a node are a contiguous piece of the linked list,
+     * so we just follow the list for the number of leaves of the node.
      */
-    const DendogramNode * next = _node->parent();
-    while( next != nullptr && &next->right() == _node ) {
-        _node = next;
-        next = next->parent();
-    }
-    _node = next;
-    if( next == nullptr )
-        return *this;
-    _node = &next->right();
-    while( !_node->leaf() )
-        _node = &_node->left();
+    if( --_remaining > 0 )
+        _leaf = _dendogram->next_leaf[_leaf];
     return *this;
 }
 
 bool operator==(const DendogramIterator & lhs, const DendogramIterator & rhs) {
-    return lhs._node == rhs._node;
+    return lhs._dendogram == rhs._dendogram &&
+        lhs._remaining == rhs._remaining &&
+        (lhs._remaining == 0 || lhs._leaf == rhs._leaf);
 }
 
 bool operator!=(const DendogramIterator & lhs, const DendogramIterator & rhs) {
-    return lhs._node != rhs._node;
-}
-
-DendogramNode::DendogramNode(
-    std::unique_ptr<DendogramNode> && left_child,
-    std::unique_ptr<DendogramNode> && right_child,
-    double linkage_distance
-) :
-    _left( std::move(left_child) ),
-    _right( std::move(right_child) ),
-    _parent( nullptr ),
-    _data( nullptr ),
-    _linkage_distance( linkage_distance ),
-    _size( _left->size() + _right->size() ),
-    _depth( std::max( _left->depth(), _right->depth() ) + 1 )
-{
-    _left->_parent = _right->_parent = this;
+    return !(lhs == rhs);
 }
 
-DendogramNode::DendogramNode( const DataEntry * data ) :
-    _parent( nullptr ),
-    _data( data ),
-    _linkage_distance( 0.0 ),
-    _size( 1 ),
-    _depth( 0 )
-{} // unique_ptr's default constructor is to be a nullptr
-
 bool DendogramNode::structural() const {
-    return _data == nullptr;
+    return _id >= _dendogram->entries.size();
 }
 
 bool DendogramNode::leaf() const {
-    return _data != nullptr;
+    return _id < _dendogram->entries.size();
+}
+
+DendogramNode DendogramNode::left() const {
+    DendogramNode node;
+    node._dendogram = _dendogram;
+    node._id = _dendogram->nodes[_id].left;
+    return node;
 }
 
-const DendogramNode & DendogramNode::left() const {
-    return *_left;
+DendogramNode DendogramNode::right() const {
+    DendogramNode node;
+    node._dendogram = _dendogram;
+    node._id = _dendogram->nodes[_id].right;
+    return node;
 }
 
-const DendogramNode & DendogramNode::right() const {
-    return *_right;
+bool DendogramNode::has_parent() const {
+    return _dendogram->nodes[_id].parent != Dendogram::none;
 }
 
-const DendogramNode * DendogramNode::parent() const {
-    return _parent;
+DendogramNode DendogramNode::parent() const {
+    DendogramNode node;
+    node._dendogram = _dendogram;
+    node._id = _dendogram->nodes[_id].parent;
+    return node;
 }
 
 const DataEntry & DendogramNode::data() const {
-    return *_data;
+    return *_dendogram->entries[_id];
 }
 
 DendogramIterator DendogramNode::begin() const {
-    if( leaf() ) {
-        DendogramIterator it;
-        it._node = this;
-        return it;
-    }
-    return left().begin();
+    DendogramIterator it;
+    it._dendogram = _dendogram;
+    it._leaf = _dendogram->nodes[_id].first_leaf;
+    it._remaining = _dendogram->nodes[_id].size;
+    return it;
 }
 
 DendogramIterator DendogramNode::end() const {
     DendogramIterator it;
-    if( _parent == nullptr ) {
-        it._node = nullptr;
-        return it;
-    }
-    /* If we have a parent,
-     * end() is not a nullptr, but begin() of the next node.
-     *
-     * We will simply descend recursively to the rightmost leaf,
-     * increment the iterator, and return.
-     */
-    if( !leaf() )
-        return right().end();
-
-    it._node = this;
-    ++it;
+    it._dendogram = _dendogram;
+    it._leaf = Dendogram::none;
+    it._remaining = 0;
     return it;
 }
 
+std::size_t DendogramNode::leaf_offset() const {
+    return _dendogram->offset[_dendogram->nodes[_id].first_leaf];
+}
+
+std::size_t DendogramNode::id() const {
+    return _id;
+}
+
 double DendogramNode::linkage_distance() const {
-    return _linkage_distance;
+    return _dendogram->nodes[_id].linkage_distance;
 }
 
 unsigned DendogramNode::size() const {
-    return _size;
+    return _dendogram->nodes[_id].size;
 }
 
 unsigned DendogramNode::depth() const {
-    return _depth;
+    return _dendogram->nodes[_id].depth;
+}
+
+bool operator==(const DendogramNode & lhs, const DendogramNode & rhs) {
+    return lhs._dendogram == rhs._dendogram && lhs._id == rhs._id;
+}
+
+bool operator!=(const DendogramNode & lhs, const DendogramNode & rhs) {
+    return !(lhs == rhs);
+}
+
+Dendogram::Dendogram( const DataSet & dataset ) :
+    Dendogram( [&](){
+        std::vector< const DataEntry * > entries;
+        entries.reserve( dataset.size() );
+        for( const DataEntry & entry : dataset )
+            entries.push_back( &entry );
+        return entries;
+    }() )
+{}
+
+Dendogram::Dendogram( std::vector< const DataEntry * > leaf_entries ) :
+    entries( std::move(leaf_entries) ),
+    next_leaf( entries.size(), none )
+{
+    unsigned n = entries.size();
+    nodes.reserve( n == 0 ? 0 : 2 * n - 1 );
+    for( unsigned i = 0; i < n; i++ )
+        nodes.push_back( {none, none, none, i, i, 1, 0, 0.0} );
+
+    if( n == 1 ) {
+        _leaf_order.push_back( 0 );
+        offset.push_back( 0 );
+    }
+}
+
+DendogramNode Dendogram::leaf( std::size_t i ) const {
+    DendogramNode node;
+    node._dendogram = this;
+    node._id = i;
+    return node;
+}
+
+DendogramNode Dendogram::merge(
+    DendogramNode left,
+    DendogramNode right,
+    double linkage_distance
+) {
+    if( left._dendogram != this || right._dendogram != this )
+        throw "Cannot merge nodes of another dendogram.";
+    if( left == right )
+        throw "Cannot merge a node with itself.";
+    if( left.has_parent() || right.has_parent() )
+        throw "Cannot merge a node that was already merged.";
+
+    unsigned id = nodes.size();
+    node_data & l = nodes[left._id];
+    node_data & r = nodes[right._id];
+    next_leaf[l.last_leaf] = r.first_leaf;
+    l.parent = r.parent = id;
+
+    // Note the push_back might invalidate l and r.
+    node_data merged{
+        left._id,
+        right._id,
+        none,
+        l.first_leaf,
+        r.last_leaf,
+        l.size + r.size,
+        std::max( l.depth, r.depth ) + 1,
+        linkage_distance
+    };
+    nodes.push_back( merged );
+
+    if( complete() ) {
+        /* Lay the leaves out in the order of the list of the root;
+         * the leaves of each node are contiguous in this list.
+         */
+        _leaf_order.resize( entries.size() );
+        offset.resize( entries.size() );
+        unsigned leaf = merged.first_leaf;
+        for( std::size_t i = 0; i < entries.size(); i++ ) {
+            _leaf_order[i] = leaf;
+            offset[leaf] = i;
+            leaf = next_leaf[leaf];
+        }
+    }
+
+    DendogramNode node;
+    node._dendogram = this;
+    node._id = id;
+    return node;
+}
+
+bool Dendogram::complete() const {
+    return !entries.empty() && nodes.size() == 2 * entries.size() - 1;
+}
+
+DendogramNode Dendogram::root() const {
+    if( !complete() )
+        throw "The dendogram is not complete.";
+    DendogramNode node;
+    node._dendogram = this;
+    node._id = nodes.size() - 1;
+    return node;
+}
+
+const std::vector< std::size_t > & Dendogram::leaf_order() const {
+    return _leaf_order;
+}
+
+std::size_t Dendogram::leaf_count() const {
+    return entries.size();
 }
@@ -1,24 +1,47 @@
 #ifndef DENDOGRAM_NODE_H
 #define DENDOGRAM_NODE_H
 
-/* Nodes of a dendogram.
+/* Dendograms and their nodes.
+ *
+ * A Dendogram stores the whole tree in flat arrays:
+ * the leaves are the nodes 0, 1, ..., n-1,
+ * and the k-th merge creates the structural node n + k.
+ * Every node is thus created exactly once, in a single allocation per array,
+ * and destroying a dendogram is not recursive.
+ *
+ * The leaves of each node are kept in a linked list
+ * that is concatenated on each merge, so the leaves of any node
+ * can be visited in linear time at any moment.
+ * Once the dendogram is complete (every leaf was merged into a single root),
+ * the leaves are also laid out in a permutation (leaf_order())
+ * in which the leaves of each node form a contiguous range.
+ *
+ * A DendogramNode is just a lightweight handle to a node of some Dendogram;
+ * it is valid as long as that Dendogram is neither destroyed nor moved.
  *
  * A dendogram node can be either structural
- * (it will have only left and right child pointers and no data)
+ * (it will have only left and right children and no data)
  * or leaf
- * (it will have no child pointers and a single data pointer).
+ * (it will have no children and a single data pointer).
  */
 
-#include <memory>
+#include <cstddef>
+#include <iterator>
+#include <vector>
 class DataEntry;
+class DataSet;
+class Dendogram;
 class DendogramNode;
 
 class DendogramIterator {
-    // Past-the-end iterators are represented with _node == nullptr.
-    const DendogramNode * _node;
+    const Dendogram * _dendogram;
+    unsigned _leaf;
+    // Number of leaves yet to visit; past-the-end iterators have zero.
+    unsigned _remaining;
     friend class DendogramNode;
 public:
     typedef const DataEntry value_type;
+    typedef std::ptrdiff_t difference_type;
     typedef const DataEntry & reference;
     typedef const DataEntry * pointer;
     typedef std::forward_iterator_tag iterator_category;
@@ -36,30 +59,11 @@ public:
 };
 
 class DendogramNode {
-    std::unique_ptr<DendogramNode> _left, _right;
-    DendogramNode * _parent;
-    const DataEntry * _data;
-
-    // Additional information
-    double _linkage_distance;
-    unsigned _size;
-    unsigned _depth;
+    const Dendogram * _dendogram;
+    unsigned _id;
+    friend class Dendogram;
 
 public:
-    /* Constructs a structural dendogram node.
-     * Each child will have its _parent attribute set to 'this'.
-     */
-    DendogramNode(
-        std::unique_ptr<DendogramNode> && left_child,
-        std::unique_ptr<DendogramNode> && right_child,
-        double linkage_distance
-    );
-
-    /* Constructs a leaf dendogram node.
-     * The given data entry will not be deleted upon destruction.
-     */
-    DendogramNode( const DataEntry * );
-
     /* Queries wether this node is structural or leaf.
      * It is guaranteed that structural() == !leaf().
      */
@@ -69,26 +73,116 @@ public:
     /* Returns the left/right child of this node.
      * Invokes undefined behavior if structural() returns false.
      */
-    const DendogramNode & left() const;
-    const DendogramNode & right() const;
+    DendogramNode left() const;
+    DendogramNode right() const;
 
-    /* Returns the parent of this node.
-     * If this node has no parent, returns nullptr.
+    /* Queries whether this node was already merged into another node,
+     * and returns that node.
+     * parent() invokes undefined behavior if has_parent() returns false.
      */
-    const DendogramNode * parent() const;
+    bool has_parent() const;
+    DendogramNode parent() const;
 
     /* Returns the data of this node.
      * Invokes undefined behavior if leaf() returns false.
      */
     const DataEntry & data() const;
 
-    // The iterator meets the requirements of an ForwardIterator.
+    /* Iterates through the data of the leaves of this node, from left to right.
+     * The iterator meets the requirements of an ForwardIterator.
+     */
     DendogramIterator begin() const;
     DendogramIterator end() const;
 
+    /* Position of the leftmost leaf of this node in leaf_order()
+     * of the dendogram; the leaves of this node are the positions
+     * [leaf_offset(), leaf_offset() + size()).
+     * Invokes undefined behavior if the dendogram is not complete.
+     */
+    std::size_t leaf_offset() const;
+
+    /* Index of this node in the dendogram:
+     * leaves have the index of their entry (0 to n-1),
+     * and the node created by the k-th merge has index n + k.
+     */
+    std::size_t id() const;
+
     double linkage_distance() const;
     unsigned size() const;
     unsigned depth() const;
+
+    friend bool operator==(const DendogramNode &, const DendogramNode &);
+    friend bool operator!=(const DendogramNode &, const DendogramNode &);
+};
+
+class Dendogram {
+    // Data of the leaves, in the order given on construction.
+    std::vector< const DataEntry * > entries;
+
+    /* Information of each node, indexed by DendogramNode::id().
+     * For leaves, children are meaningless.
+     */
+    struct node_data {
+        unsigned left;
+        unsigned right;
+        unsigned parent;
+        unsigned first_leaf;
+        unsigned last_leaf;
+        unsigned size;
+        unsigned depth;
+        double linkage_distance;
+    };
+    std::vector< node_data > nodes;
+
+    /* next_leaf[l] is the leaf after l in the leaf list of the topmost node
+     * that contains l.
+     */
+    std::vector< unsigned > next_leaf;
+
+    // Filled when the dendogram is completed.
+    std::vector< std::size_t > _leaf_order;
+    std::vector< unsigned > offset;
+
+    static constexpr unsigned none = -1;
+    friend class DendogramNode;
+    friend class DendogramIterator;
+
+public:
+    /* Constructs a dendogram with one leaf for each entry
+     * and no structural nodes.
+     * The entries will not be deleted upon destruction.
+     */
+    explicit Dendogram( const DataSet & );
+    explicit Dendogram( std::vector< const DataEntry * > entries );
+
+    /* Returns the leaf for the i-th entry.
+     */
+    DendogramNode leaf( std::size_t i ) const;
+
+    /* Creates a structural node with the given children and linkage distance,
+     * and returns it.
+     * Both nodes must belong to this dendogram, be distinct,
+     * and have no parent yet; otherwise, this function throws.
+     */
+    DendogramNode merge( DendogramNode left, DendogramNode right, double linkage_distance );
+
+    /* Queries whether the dendogram has a single root;
+     * that is, whether exactly n-1 merges were done.
+     */
+    bool complete() const;
+
+    /* Returns the root of the dendogram.
+     * Throws if the dendogram is not complete.
+     */
+    DendogramNode root() const;
+
+    /* Permutation of the entry indices that lists the leaves
+     * from left to right. See DendogramNode::leaf_offset().
+     * Empty while the dendogram is not complete.
+     */
+    const std::vector< std::size_t > & leaf_order() const;
+
+    std::size_t leaf_count() const;
 };
 
 #endif // DENDOGRAM_NODE_H
@@ -0,0 +1,217 @@
+/* Implementation of distance_matrix.h.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "distance_matrix.h"
+#include "pr/data_set.h"
+#include "util/parallel.hpp"
+
+/* std::fma is a single instruction only on processors with FMA,
+ * and the compiler vectorizes it only when it may use that instruction;
+ * otherwise each call goes to the library.
+ * On x86-64, accumulate_squares is compiled twice, with and without FMA,
+ * and the loader picks the version for the running processor.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FMA_CLONES __attribute__(( target_clones( "fma", "default" ) ))
+#else
+#define FMA_CLONES
+#endif
+
+namespace {
+    /* out[j] += (column[j] - x)^2, for 0 <= j < count,
+     * with the same rounding of EuclideanDistance.
+     */
+    FMA_CLONES
+    void accumulate_squares( const double * column, double x, double * out, std::size_t count ) {
+        for( std::size_t j = 0; j < count; j++ )
+            out[j] = std::fma( column[j] - x, column[j] - x, out[j] );
+    }
+} // anonymous namespace
+
+DistanceMatrix::DistanceMatrix( std::size_t size, const DistanceStorage & storage ) :
+    _size( size ),
+    single_precision( storage.single_precision ),
+    values( nullptr ),
+    bytes( (size < 2 ? 0 : size * (size - 1) / 2) *
+        (storage.single_precision ? sizeof(float) : sizeof(double)) ),
+    mapped( false )
+{
+    if( bytes == 0 )
+        return;
+
+    if( storage.file.empty() ) {
+        // calloc gives zeroed memory, usually without touching the pages.
+        values = std::calloc( bytes, 1 );
+        if( values == nullptr )
+            throw "Not enough memory for the distance matrix.";
+        return;
+    }
+
+    // O_EXCL: never truncate (and then unlink) a file of the user.
+    int fd = open( storage.file.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+    if( fd == -1 ) {
+        if( errno == EEXIST )
+            throw "The distance matrix file already exists.";
+        throw "Could not create the distance matrix file.";
+    }
+    if( ftruncate( fd, bytes ) != 0 ) {
+        close( fd );
+        unlink( storage.file.c_str() );
+        throw "Could not resize the distance matrix file.";
+    }
+    values = mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    /* The mapping keeps the file alive,
+     * so neither the descriptor nor the directory entry are needed anymore.
+     */
+    close( fd );
+    unlink( storage.file.c_str() );
+    if( values == MAP_FAILED ) {
+        values = nullptr;
+        throw "Could not map the distance matrix file.";
+    }
+    mapped = true;
+}
+
+void DistanceMatrix::release() {
+    if( mapped )
+        munmap( values, bytes );
+    else
+        std::free( values );
+    values = nullptr;
+}
+
+DistanceMatrix::~DistanceMatrix() {
+    release();
+}
+
+DistanceMatrix::DistanceMatrix( DistanceMatrix && other ) :
+    _size( other._size ),
+    single_precision( other.single_precision ),
+    values( other.values ),
+    bytes( other.bytes ),
+    mapped( other.mapped )
+{
+    other.values = nullptr;
+    other.mapped = false;
+}
+
+DistanceMatrix & DistanceMatrix::operator=( DistanceMatrix && other ) {
+    if( this != &other ) {
+        release();
+        _size = other._size;
+        single_precision = other.single_precision;
+        values = other.values;
+        bytes = other.bytes;
+        mapped = other.mapped;
+        other.values = nullptr;
+        other.mapped = false;
+    }
+    return *this;
+}
+
+std::size_t DistanceMatrix::index( std::size_t i, std::size_t j ) const {
+    if( i > j )
+        std::swap( i, j );
+    /* The rows before i have (size-1) + (size-2) + ... + (size-i) elements.
+     */
+    return i * (2 * _size - i - 1) / 2 + (j - i - 1);
+}
+
+double DistanceMatrix::operator()( std::size_t i, std::size_t j ) const {
+    if( single_precision )
+        return static_cast< const float * >( values )[index(i, j)];
+    return static_cast< const double * >( values )[index(i, j)];
+}
+
+void DistanceMatrix::set( std::size_t i, std::size_t j, double distance ) {
+    if( single_precision )
+        static_cast< float * >( values )[index(i, j)] = distance;
+    else
+        static_cast< double * >( values )[index(i, j)] = distance;
+}
+
+void DistanceMatrix::get_row( std::size_t i, double * output ) const {
+    std::size_t begin = index( i, i + 1 );
+    std::size_t count = _size - i - 1;
+    if( single_precision )
+        std::copy_n( static_cast< const float * >( values ) + begin, count, output );
+    else
+        std::copy_n( static_cast< const double * >( values ) + begin, count, output );
+}
+
+void DistanceMatrix::set_row( std::size_t i, const double * input ) {
+    std::size_t begin = index( i, i + 1 );
+    std::size_t count = _size - i - 1;
+    if( single_precision )
+        std::copy_n( input, count, static_cast< float * >( values ) + begin );
+    else
+        std::copy_n( input, count, static_cast< double * >( values ) + begin );
+}
+
+std::size_t DistanceMatrix::size() const {
+    return _size;
+}
+
+EuclideanDistances::EuclideanDistances( const DataSet & dataset ) :
+    _size( dataset.size() ),
+    attribute_count( dataset.attribute_count() ),
+    coordinates( _size * attribute_count )
+{
+    for( std::size_t i = 0; i < _size; i++ )
+        for( std::size_t a = 0; a < attribute_count; a++ )
+            coordinates[a * _size + i] = dataset.begin()[i].attribute(a);
+}
+
+void EuclideanDistances::distances(
+    std::size_t i,
+    std::size_t begin,
+    std::size_t end,
+    double * output
+) const {
+    /* The output is processed in tiles that fit in the L1 cache,
+     * and each tile is swept once per attribute.
+     */
+    const std::size_t tile = 512;
+    for( std::size_t b = begin; b < end; b += tile ) {
+        std::size_t e = std::min( b + tile, end );
+        double * out = output + (b - begin);
+        std::fill( out, out + (e - b), 0.0 );
+
+        for( std::size_t a = 0; a < attribute_count; a++ ) {
+            const double * column = coordinates.data() + a * _size;
+            accumulate_squares( column + b, column[i], out, e - b );
+        }
+
+        for( std::size_t j = b; j < e; j++ )
+            out[j - b] = std::sqrt( out[j - b] );
+    }
+}
+
+DistanceMatrix EuclideanDistances::matrix( const DistanceStorage & storage ) const {
+    DistanceMatrix result( _size, storage );
+    /* The rows get shorter as i grows,
+     * but the blocks are handed to the threads on demand,
+     * so the work is still balanced.
+     * The matrix is written row by row, sequentially,
+     * which is the best order for a memory-mapped matrix.
+     */
+    util::parallel_blocks( 0, _size, 16, [&]( std::size_t begin, std::size_t end ) {
+        std::vector< double > row( _size );
+        for( std::size_t i = begin; i < end; i++ ) {
+            distances( i, i + 1, _size, row.data() );
+            result.set_row( i, row.data() );
+        }
+    });
+    return result;
+}
+
+std::size_t EuclideanDistances::size() const {
+    return _size;
+}
@@ -0,0 +1,114 @@
+#ifndef PR_DISTANCE_MATRIX_H
+#define PR_DISTANCE_MATRIX_H
+
+/* Symmetric matrix of pairwise distances, with zero diagonal.
+ *
+ * Only the strict upper triangle is stored, row by row,
+ * in a single array of n(n-1)/2 values:
+ * the row i holds the distances (i, i+1), (i, i+2), ..., (i, n-1).
+ *
+ * The array may hold doubles or floats,
+ * and may live either in memory or in a memory-mapped file;
+ * see DistanceStorage.
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class DataSet;
+
+/* How the DistanceMatrix stores its values.
+ *
+ *  single_precision
+ *      Store the distances as floats instead of doubles,
+ *      halving the memory usage.
+ *      The distances are rounded when stored.
+ *
+ *  file
+ *      If not empty, the values are kept in a memory-mapped file
+ *      created with this name, instead of in the heap;
+ *      the file must not exist yet.
+ *      thus, the operating system may page them out to that file
+ *      instead of to the swap area.
+ *      The file is removed from the directory as soon as it is mapped,
+ *      so it never outlives the matrix.
+ */
+struct DistanceStorage {
+    bool single_precision = false;
+    std::string file;
+};
+
+class DistanceMatrix {
+    std::size_t _size;
+    bool single_precision;
+
+    // Either heap or mapped memory, with n(n-1)/2 doubles or floats.
+    void * values;
+    std::size_t bytes;
+    bool mapped;
+
+    std::size_t index( std::size_t i, std::size_t j ) const;
+    void release();
+
+public:
+    /* Constructs a matrix for `size` points, with every distance zero.
+     * Throws if the file already exists or cannot be created or mapped.
+     */
+    explicit DistanceMatrix( std::size_t size, const DistanceStorage & = {} );
+    ~DistanceMatrix();
+
+    DistanceMatrix( DistanceMatrix && );
+    DistanceMatrix & operator=( DistanceMatrix && );
+    DistanceMatrix( const DistanceMatrix & ) = delete;
+    DistanceMatrix & operator=( const DistanceMatrix & ) = delete;
+
+    /* Distance between the points i and j.
+     * The order of the indices is irrelevant,
+     * but they must be distinct and smaller than size().
+     */
+    double operator()( std::size_t i, std::size_t j ) const;
+    void set( std::size_t i, std::size_t j, double distance );
+
+    /* Copies the values of the row i of the upper triangle;
+     * that is, the distances (i, i+1), ..., (i, size()-1),
+     * to/from the given array, which must have size() - i - 1 elements.
+     */
+    void get_row( std::size_t i, double * output ) const;
+    void set_row( std::size_t i, const double * input );
+
+    std::size_t size() const;
+};
+
+/* Computes the euclidean distances between the entries of a dataset,
+ * without normalization; that is, the same values of EuclideanDistance(0).
+ *
+ * The attributes are copied in attribute-major order,
+ * so the inner loops run over consecutive entries.
+ * On x86-64, when compiled with -O3, the loops are vectorized
+ * on processors with FMA, which keeps the rounding of EuclideanDistance.
+ */
+class EuclideanDistances {
+    std::size_t _size;
+    std::size_t attribute_count;
+
+    // The attribute a of the entry i is coordinates[a * _size + i].
+    std::vector< double > coordinates;
+
+public:
+    explicit EuclideanDistances( const DataSet & );
+
+    /* Writes to output[k] the distance between the entries i and begin + k,
+     * for every begin <= begin + k < end.
+     */
+    void distances( std::size_t i, std::size_t begin, std::size_t end, double * output ) const;
+
+    /* Returns the matrix of the distances between every pair of entries.
+     * The rows are computed in parallel; see util/parallel.hpp.
+     */
+    DistanceMatrix matrix( const DistanceStorage & = {} ) const;
+
+    std::size_t size() const;
+};
+
+#endif // PR_DISTANCE_MATRIX_H
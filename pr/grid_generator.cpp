@@ -45,51 +45,78 @@ DataEntry GridGenerator::operator()( const std::vector<unsigned> & index ) const
 
     std::vector< double > attributes( size );
     for( unsigned i = 0; i < size; i++ )
-        attributes[i] = index[i] * step[i] + shift[i];
+        attributes[i] = coordinate( i, index[i] );
 
     return DataEntry( std::move(attributes), {} );
 }
 
+double GridGenerator::coordinate( std::size_t dimension, unsigned index ) const {
+    return index * step[dimension] + shift[dimension];
+}
+
+std::size_t GridGenerator::size() const {
+    std::size_t size = 1;
+    for( unsigned d : _density )
+        size *= d + 1;
+    return size;
+}
+
+void GridGenerator::fill( std::size_t begin, std::size_t count, double * output ) const {
+    if( begin > size() || count > size() - begin )
+        throw "Range of grid points past the end of the grid.";
+    std::size_t dim = _density.size();
+    if( count == 0 || dim == 0 )
+        return;
+
+    // Index of the point `begin`; the last dimension varies fastest.
+    std::vector< unsigned > index( dim );
+    std::size_t position = begin;
+    for( std::size_t i = dim; i-- > 0; ) {
+        index[i] = position % (_density[i] + 1);
+        position /= _density[i] + 1;
+    }
+
+    for( std::size_t k = 0; k < count; k++ ) {
+        for( std::size_t i = 0; i < dim; i++ )
+            output[k * dim + i] = coordinate( i, index[i] );
+
+        // Advance the index like an odometer.
+        for( std::size_t i = dim; i-- > 0; ) {
+            if( ++index[i] <= _density[i] )
+                break;
+            index[i] = 0;
+        }
+    }
+}
+
 Iterator GridGenerator::begin() const {
     GridIterator it;
-    it.index.resize( _density.size() );
-    it.expired = false;
+    it.position = 0;
     it.grid = this;
     return it;
 }
 
 Iterator GridGenerator::end() const {
     GridIterator it;
-    it.expired = true;
+    it.position = size();
     it.grid = this;
     return it;
 }
 
 
 DataEntry Iterator::operator*() const {
-    return grid->operator()( index );
+    std::vector< double > attributes( grid->density().size() );
+    grid->fill( position, 1, attributes.data() );
+    return DataEntry( std::move(attributes), {} );
 }
 
 Iterator & Iterator::operator++() {
-    for( int i = index.size() - 1; ; i-- ) {
-        if( i < 0 ) {
-            expired = true;
-            break;
-        }
-        index[i]++;
-        if( index[i] > grid->density()[i] )
-            index[i] = 0;
-        else
-            break;
-    }
+    ++position;
     return *this;
 }
 
 bool operator==( const Iterator & lhs, const Iterator & rhs ) {
-    if( lhs.expired || rhs.expired )
-        return rhs.expired && rhs.expired;
-
-    return lhs.index == rhs.index;
+    return lhs.position == rhs.position;
 }
 
 bool operator!=( const Iterator & lhs, const Iterator & rhs ) {
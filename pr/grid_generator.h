@@ -2,8 +2,13 @@
 #define PR_GRID_GENERATOR_H
 
 /* Generates an uniform list of entries.
+ *
+ * The grid has density()[i] + 1 points in the dimension i,
+ * and its points are listed with the last dimension varying fastest.
+ * The position of a point in this list is its linear position.
  */
 
+#include <cstddef>
 #include <vector>
 #include "pr/data_entry.h"
 #include "pr/data_set.h"
@@ -43,13 +48,37 @@ public:
      */
     DataEntry operator()( const std::vector<unsigned> & ) const;
 
+    /* Returns the attribute `dimension` of the points
+     * whose index in that dimension is `index`.
+     * The grid is the cartesian product of these coordinates.
+     */
+    double coordinate( std::size_t dimension, unsigned index ) const;
+
+    /* Number of points of the grid.
+     */
+    std::size_t size() const;
+
+    /* Writes the attributes of the points in the linear positions
+     * [begin, begin + count) to output, one point after the other;
+     * that is, the attribute a of the point begin + k
+     * goes to output[k * density().size() + a].
+     * A whole row of the grid is the range
+     * [r * (density().back() + 1), (r+1) * (density().back() + 1)).
+     *
+     * No DataEntry is created, so this is the way to evaluate dense grids.
+     * Throws if the range goes past size().
+     */
+    void fill( std::size_t begin, std::size_t count, double * output ) const;
+
     /* Iterator that generates all grid entries.
      * The iterator assumes the underlying generator
      * to be untouched during its operation.
+     *
+     * The iterator holds only the linear position,
+     * so it is cheap to copy; the point is computed on dereference.
      */
     class GridIterator {
-        std::vector<unsigned> index;
-        bool expired;
+        std::size_t position;
         const GridGenerator * grid;
 
         friend class GridGenerator;
@@ -1,12 +1,27 @@
 #include <algorithm>
 #include <cfloat>
 #include <chrono>
-#include <list>
+#include <cstdint>
 #include <map>
 #include <random>
 #include "ibl.h"
+#include "pr/kd_tree.h"
 #include "pr/p_norm.h"
 #include "util/interval.h"
+#include "util/parallel.hpp"
+#include "util/stats.h"
+
+namespace {
+    util::stats::counter ibl3_distance_evaluations( "ibl3.distance_evaluations" );
+    util::stats::counter ibl3_random_choices( "ibl3.random_choices" );
+    util::stats::counter ibl3_removed_instances( "ibl3.removed_instances" );
+    util::stats::counter ibl3_compactions( "ibl3.compactions" );
+    // Live instances after each number of trained entries.
+    util::stats::series ibl3_descriptor_size( "ibl3.descriptor_size" );
+
+    // Number of samples of ibl3.descriptor_size in each training.
+    const std::size_t descriptor_samples = 32;
+} // anonymous namespace
 
 void ibl1::train( const DataSet & dataset ) {
     nn = std::make_unique<NearestNeighbor>(
@@ -16,20 +31,33 @@ void ibl1::train( const DataSet & dataset ) {
         false
     );
 
-    auto it = dataset.begin();
+    /* nn.edit_dataset() will be our conceptual descriptor.
+     *
+     * IBL 1 keeps every entry, so the conceptual descriptor
+     * seen by the ith entry is simply the first i entries of the dataset.
+     * That means all the classifications are independent:
+     * we index the whole dataset once and run every query in parallel,
+     * restricting the ith query to the points with ids smaller than i.
+     */
+    KDTree index( dataset.attribute_count() );
+    for( const DataEntry & entry : dataset ) {
+        index.insert( entry );
+        nn->edit_dataset().push_back( DataEntry(entry) );
+    }
+
+    const DataEntry * entries = dataset.begin();
+    std::vector< char > correct( dataset.size() );
+    util::parallel_for( 1, dataset.size(), [&]( std::size_t i ) {
+        std::size_t closest = index.nearest( entries[i], i );
+        correct[i] = entries[closest].categories() == entries[i].categories();
+    });
 
-    /* nn.edit_dataset() will be our conceptual descriptor. */
-    nn->edit_dataset().push_back( DataEntry(*it) );
     ++miss;
-    while( ++it != dataset.end() ) {
-        auto category = nn->classify( *it );
-        if( category == it->categories() )
+    for( std::size_t i = 1; i < dataset.size(); i++ )
+        if( correct[i] )
             ++hit;
         else
             ++miss;
-
-        nn->edit_dataset().push_back( DataEntry(*it) );
-    }
 }
 
 int ibl1::hit_count() const {
@@ -55,15 +83,21 @@ void ibl2::train( const DataSet & dataset ) {
 
     auto it = dataset.begin();
 
-    /* nn.edit_dataset() will be our conceptual descriptor. */
+    /* nn.edit_dataset() will be our conceptual descriptor.
+     * The kd-tree mirrors it: the point with id i
+     * is the ith entry of the conceptual descriptor.
+     */
+    KDTree index( dataset.attribute_count() );
+    index.insert( *it );
     nn->edit_dataset().push_back( DataEntry(*it) );
     ++miss;
     while( ++it != dataset.end() ) {
-        auto category = nn->classify( *it );
-        if( category == it->categories() )
+        const DataEntry & closest = nn->dataset().begin()[ index.nearest(*it) ];
+        if( closest.categories() == it->categories() )
             ++hit;
         else {
             ++miss;
+            index.insert( *it );
             nn->edit_dataset().push_back( DataEntry(*it) );
         }
     }
@@ -83,9 +117,9 @@ const NearestNeighbor & ibl2::nearest_neighbor() const {
 }
 
 ibl3::ibl3( double accepting_threshold, double rejecting_threshold ):
+    _seed( std::chrono::system_clock::now().time_since_epoch().count() ),
     accepting_threshold( accepting_threshold ),
-    rejecting_threshold( rejecting_threshold ),
-    _seed( std::chrono::system_clock::now().time_since_epoch().count() )
+    rejecting_threshold( rejecting_threshold )
 {}
 
 double ibl3::do_distance( const DataEntry & lhs, const DataEntry & rhs ) const {
@@ -97,6 +131,9 @@ void ibl3::do_update_weights( const DataEntry &, const DataEntry &, double ) {
 std::unique_ptr<DistanceCalculator> ibl3::do_distance_calculator() const {
     return std::unique_ptr<DistanceCalculator>(new EuclideanDistance(0.0));
 }
+const std::vector<double> * ibl3::do_attribute_weights() const {
+    return nullptr;
+}
 void ibl3::seed( long long unsigned seed ) {
     _seed = seed;
 }
@@ -115,6 +152,10 @@ void ibl3::train( const DataSet & dataset ) {
     struct instance {
         DataEntry entry;
 
+        /* Id of the category of the entry; see category_id below.
+         */
+        std::size_t category;
+
         /* How many times this entry was used to classify an entry.
          */
         int use_count;
@@ -122,44 +163,91 @@ void ibl3::train( const DataSet & dataset ) {
         /* How many times the classification went right.
          */
         int correct_use_count;
+
+        /* Removed instances are only marked as dead;
+         * see the compaction below.
+         */
+        bool alive;
+
+        /* Precision intervals of this instance
+         * under the accepting and rejecting thresholds.
+         * They depend only on the counts above,
+         * so they are recomputed only when the counts change.
+         * Meaningless while use_count == 0.
+         */
+        interval accepting_precision;
+        interval rejecting_precision;
     };
 
     /* The conceptual descriptor may grow and shrink during the execution
      * of the training, so we will only write to _conceptual_descriptor
      * an the end of the algorithm.
      *
-     * Note we are using a std::list instead of a std::set.
-     * Three reasons:
-     * 1. 'instance' does not have operator<.
-     * 2. std::list has a nice O(1) element removal through iterators.
-     * 3. We do not need ordering anyway...
+     * The instances are stored contiguously, in insertion order.
+     * Removing an instance just marks it as dead;
+     * once the dead instances outnumber the live ones,
+     * the vector is compacted.
+     *
+     * The kd-tree indexes the same instances:
+     * the point with id i is conceptual_descriptor[i].
      */
-    std::list< instance > conceptual_descriptor;
+    std::vector< instance > conceptual_descriptor;
+    KDTree index( dataset.attribute_count() );
+    std::size_t live_instances = 0;
 
     /* Number of already processed instances in this training.
      */
     std::size_t trained_instances_count = 0;
 
-    /* category_appearance_count[str] is how many times an entity of category str
+    /* The categories are numbered in order of appearance;
+     * category_appearance_count[id] is how many times an entity of that category
      * already appeared in the training set.
      */
-    std::map< std::string, std::size_t > category_appearance_count;
+    std::map< std::string, std::size_t > category_id;
+    std::vector< std::size_t > category_appearance_count;
+
+    /* Frequency intervals of each category, under the accepting
+     * and rejecting thresholds.
+     * They depend only on the counts above, which change once per step,
+     * so they are computed once per step instead of once per instance.
+     */
+    std::vector< interval > accepting_frequency;
+    std::vector< interval > rejecting_frequency;
+
+    /* The (correct_use_count, use_count) pairs repeat a lot,
+     * so the precision intervals are memoized.
+     */
+    interval_table accepting_precision( this->accepting_threshold );
+    interval_table rejecting_precision( this->rejecting_threshold );
+
+    /* Accounts for one more training entry,
+     * updating every quantity that depends on the category counts.
+     * Returns the id of the entry category.
+     */
+    auto count = [&]( const DataEntry & entry ) {
+        auto insertion = category_id.emplace( entry.category(0), category_id.size() );
+        std::size_t id = insertion.first->second;
+        if( insertion.second )
+            category_appearance_count.push_back( 0 );
+        category_appearance_count[id]++;
+        trained_instances_count++;
 
-    /* Returns a std::pair with the the precision and frequency intervals
-     * for that instance, respectively, given the acceptance threshold.
+        int n = trained_instances_count;
+        accepting_frequency.resize( category_appearance_count.size() );
+        rejecting_frequency.resize( category_appearance_count.size() );
+        for( std::size_t c = 0; c < category_appearance_count.size(); c++ ) {
+            double p = (double) category_appearance_count[c] / n;
+            accepting_frequency[c] = frequency_interval( p, n, this->accepting_threshold );
+            rejecting_frequency[c] = frequency_interval( p, n, this->rejecting_threshold );
+        }
+        return id;
+    };
+
+    /* Must be called whenever the counts of the instance change.
      */
-    auto intervals = [&]( const instance & i, double z ) {
-        double p; int n;
-        p = (double) i.correct_use_count / i.use_count;
-        n = i.use_count;
-        interval precision = precision_interval( p, n, z );
-
-        auto appearances = category_appearance_count[i.entry.category(0)];
-        p = (double) appearances / trained_instances_count;
-        n = trained_instances_count;
-        interval frequency = frequency_interval( p, n, z );
-
-        return std::make_pair( precision, frequency );
+    auto update_precision = [&]( instance & i ) {
+        i.accepting_precision = accepting_precision( i.correct_use_count, i.use_count );
+        i.rejecting_precision = rejecting_precision( i.correct_use_count, i.use_count );
     };
 
     /* Returns true if the specified instance is acceptable;
@@ -171,8 +259,7 @@ void ibl3::train( const DataSet & dataset ) {
      */
     auto acceptable = [&]( const instance & i ) {
         if( i.use_count == 0 ) return true;
-        auto pair = intervals( i, this->accepting_threshold );
-        return pair.second.max <= pair.first.min;
+        return accepting_frequency[i.category].max <= i.accepting_precision.min;
     };
 
     /* Returns true if the specified instance should be discarded;
@@ -185,35 +272,79 @@ void ibl3::train( const DataSet & dataset ) {
      */
     auto rejectable = [&]( const instance & i ) {
         if( i.use_count == 0 ) return false;
-        auto pair = intervals( i, this->rejecting_threshold );
-        return pair.first.max <= pair.second.min;
+        return i.rejecting_precision.max <= rejecting_frequency[i.category].min;
     };
 
+    auto add = [&]( const DataEntry & entry, std::size_t category ) {
+        conceptual_descriptor.push_back( {entry, category, 0, 0, true, {}, {}} );
+        index.insert( entry );
+        live_instances++;
+    };
+
+    /* Rebuilds the conceptual descriptor and the index without the dead instances.
+     */
+    auto compact = [&]() {
+        std::vector< instance > survivors;
+        survivors.reserve( live_instances );
+        KDTree new_index( dataset.attribute_count() );
+        for( instance & i : conceptual_descriptor )
+            if( i.alive ) {
+                new_index.insert( i.entry );
+                survivors.push_back( std::move(i) );
+            }
+        conceptual_descriptor = std::move( survivors );
+        index = std::move( new_index );
+    };
+
+    /* Statistics are tallied locally, and added to util::stats at the end,
+     * so that the kd-tree searches pay nothing for them.
+     */
+    std::uint64_t distance_evaluations = 0;
+    std::uint64_t random_choices = 0;
+    std::uint64_t removed_instances = 0;
+    std::size_t sample_step = std::max< std::size_t >( 1, dataset.size() / descriptor_samples );
+
     // The algoritm begins here.
-    conceptual_descriptor.push_back( {*it, 0, 0} );
+    add( *it, count(*it) );
     miss++;
-    category_appearance_count[it->category(0)]++;
-    trained_instances_count++;
 
     while( ++it != dataset.end() ) {
+        if( trained_instances_count % sample_step == 0 )
+            ibl3_descriptor_size.record( trained_instances_count, live_instances );
+
+        KDTree::Distance distance_to = [&]( std::size_t id ) {
+            distance_evaluations++;
+            return do_distance( conceptual_descriptor[id].entry, *it );
+        };
+
         // First, lets find a closest acceptable instance.
-        auto closest_acceptable = conceptual_descriptor.end();
-        double distance_to_closest = DBL_MAX;
-        for( auto jt = conceptual_descriptor.begin();
-            jt != conceptual_descriptor.end();
-            ++jt )
-        {
-            if( acceptable(*jt) )
-                if( do_distance(jt->entry, *it) < distance_to_closest )
-                    closest_acceptable = jt;
+        std::size_t closest_acceptable = index.nearest(
+            *it,
+            distance_to,
+            [&]( std::size_t id ) {
+                const instance & i = conceptual_descriptor[id];
+                return i.alive && acceptable( i );
+            },
+            do_attribute_weights()
+        );
+
+        /* Every instance may have been discarded;
+         * in this case, start over as in the first entry.
+         */
+        if( live_instances == 0 ) {
+            add( *it, count(*it) );
+            miss++;
+            continue;
         }
 
         // If there is no acceptable instances in the conceptual descriptor,
         // let's choose a random entry.
-        if( closest_acceptable == conceptual_descriptor.end() ) {
-            int random = rng() % conceptual_descriptor.size();
-            closest_acceptable = conceptual_descriptor.begin();
-            std::advance( closest_acceptable, random );
+        if( closest_acceptable == KDTree::npos ) {
+            random_choices++;
+            std::size_t random = rng() % live_instances;
+            closest_acceptable = 0;
+            while( !conceptual_descriptor[closest_acceptable].alive || random-- > 0 )
+                closest_acceptable++;
             /* All the presentations of the algorithm I've seen
              * actually tell to choose 'r' as a random number between
              * 1 and the size of the conceptual descriptor,
@@ -234,55 +365,97 @@ void ibl3::train( const DataSet & dataset ) {
          * as a possibly good classifier.
          */
 
-        trained_instances_count++;
-        category_appearance_count[it->category(0)]++;
+        std::size_t category = count( *it );
+
+        instance & closest = conceptual_descriptor[closest_acceptable];
+        closest.use_count++;
+        bool correct = closest.entry.categories() == it->categories();
+        if( correct )
+            closest.correct_use_count++;
+        update_precision( closest );
 
-        closest_acceptable->use_count++;
-        if( closest_acceptable->entry.categories() == it->categories() ) {
+        /* We need to save the current closest entry,
+         * because it might get removed form the conceptual descriptor,
+         * but we need that entry to call do_update_weights.
+         * (Adding the new instance may also move the vector around.)
+         */
+        DataEntry closest_entry = closest.entry;
+        std::size_t closest_category = closest.category;
+        double threshold = do_distance( closest_entry, *it );
+        distance_evaluations++;
+
+        if( correct )
             hit++;
-            closest_acceptable->correct_use_count++;
-        }
         else {
             miss++;
-            conceptual_descriptor.push_back( {*it, 0, 0} );
+            add( *it, category );
         }
 
-        /* Now, remove from the conceptual descriptor every bad classifier.
-         * First, we need to save the current closest entry,
-         * because the pointer closest_aceptable might get removed
-         * form the conceptual descriptor, but we need that entry
-         * to call do_update_weights.
+        /* Now, remove from the conceptual descriptor every bad classifier
+         * that is not farther than the closest instance.
          */
-        DataEntry closest_entry = closest_acceptable->entry;
-        double threshold = do_distance(closest_acceptable->entry, *it);
-        auto jt = conceptual_descriptor.begin();
-        while( jt != conceptual_descriptor.end() )
-            if( do_distance(jt->entry, *it) <= threshold && rejectable(*jt) )
-                jt = conceptual_descriptor.erase( jt );
-            else
-                ++jt;
+        index.within(
+            *it,
+            threshold,
+            distance_to,
+            [&]( std::size_t id ) {
+                return conceptual_descriptor[id].alive;
+            },
+            [&]( std::size_t id ) {
+                instance & i = conceptual_descriptor[id];
+                if( rejectable(i) ) {
+                    i.alive = false;
+                    live_instances--;
+                    removed_instances++;
+                }
+            },
+            do_attribute_weights()
+        );
+
+        if( conceptual_descriptor.size() - live_instances > live_instances ) {
+            compact();
+            ibl3_compactions.add();
+        }
 
         // And finnaly, update the metric.
         double lambda =
             std::max(
-                category_appearance_count[it->category(0)],
-                category_appearance_count[closest_entry.category(0)]
+                category_appearance_count[category],
+                category_appearance_count[closest_category]
             )
             / (double) trained_instances_count;
 
-        do_update_weights( *it, closest_acceptable->entry, lambda );
+        do_update_weights( *it, closest_entry, lambda );
 
     } // while( it != dataset.end() )
 
+    ibl3_descriptor_size.record( trained_instances_count, live_instances );
+    ibl3_distance_evaluations.add( distance_evaluations );
+    ibl3_random_choices.add( random_choices );
+    ibl3_removed_instances.add( removed_instances );
+
     // Now, we must store the data in the conceptual_descriptor
     // inside our instance dataset _conceptual_descriptor.
     _conceptual_descriptor = dataset.header();
 
     for( instance & i : conceptual_descriptor )
-        if( i.use_count > 0 )
+        if( i.alive && i.use_count > 0 )
             _conceptual_descriptor.push_back( std::move(i.entry) );
 }
 
+void ibl3::merge_start( const DataSet & header ) {
+    _conceptual_descriptor = header;
+    hit = 0;
+    miss = 0;
+}
+
+void ibl3::merge( const ibl3 & shard ) {
+    hit += shard.hit;
+    miss += shard.miss;
+    for( const DataEntry & entry : shard._conceptual_descriptor )
+        _conceptual_descriptor.push_back( DataEntry(entry) );
+}
+
 int ibl3::hit_count() const {
     return hit;
 }
@@ -336,6 +509,9 @@ double ibl4::do_distance( const DataEntry & x, const DataEntry & y ) const {
 std::unique_ptr<DistanceCalculator> ibl4::do_distance_calculator() const {
     return std::unique_ptr<DistanceCalculator>(new WeightedDistance{& weights});
 }
+const std::vector<double> * ibl4::do_attribute_weights() const {
+    return &weights;
+}
 void ibl4::do_update_weights( const DataEntry & a, const DataEntry & b, double lambda ) {
     for( std::size_t i = 0; i < weights.size(); i++ ) {
         double d = std::fabs(a.attribute(i) - b.attribute(i));
@@ -350,9 +526,61 @@ void ibl4::do_update_weights( const DataEntry & a, const DataEntry & b, double l
         weights[i] = std::max( accumulated_weights[i] / normalized_weights[i] - .5, 0. );
     }
 }
+void ibl4::shards( unsigned count ) {
+    if( count == 0 )
+        throw "IBL 4 needs at least one shard.";
+    _shards = count;
+}
+unsigned ibl4::shards() const {
+    return _shards;
+}
 void ibl4::train( const DataSet & dataset ) {
+    if( _shards > 1 && dataset.size() >= _shards ) {
+        train_shards( dataset );
+        return;
+    }
     weights.resize( dataset.attribute_count(), 1.0 );
     accumulated_weights.resize( dataset.attribute_count(), 1.0 );
     normalized_weights.resize( dataset.attribute_count(), 1.0 );
     ibl3::train( dataset );
 }
+
+void ibl4::train_shards( const DataSet & dataset ) {
+    std::vector< std::unique_ptr<ibl4> > trained( _shards );
+    std::size_t size = dataset.size();
+
+    util::parallel_for( 0, _shards, [&]( std::size_t s ) {
+        DataSet piece = dataset.header();
+        auto end = dataset.begin() + size * (s+1) / _shards;
+        for( auto it = dataset.begin() + size * s / _shards; it != end; ++it )
+            piece.push_back( DataEntry(*it) );
+
+        std::seed_seq sequence{
+            (unsigned) seed(), (unsigned) (seed() >> 32), (unsigned) s
+        };
+        std::uint32_t words[2];
+        sequence.generate( words, words + 2 );
+
+        trained[s] = std::make_unique<ibl4>( accepting_threshold, rejecting_threshold );
+        trained[s]->seed( (long long unsigned) words[1] << 32 | words[0] );
+        trained[s]->train( piece );
+    });
+
+    /* Each shard starts with all the accumulators equal to 1,
+     * so only the increments are added up.
+     */
+    std::size_t attributes = dataset.attribute_count();
+    accumulated_weights.assign( attributes, 1.0 );
+    normalized_weights.assign( attributes, 1.0 );
+    weights.resize( attributes );
+    merge_start( dataset.header() );
+    for( const auto & shard : trained ) {
+        for( std::size_t i = 0; i < attributes; i++ ) {
+            accumulated_weights[i] += shard->accumulated_weights[i] - 1;
+            normalized_weights[i] += shard->normalized_weights[i] - 1;
+        }
+        merge( *shard );
+    }
+    for( std::size_t i = 0; i < attributes; i++ )
+        weights[i] = std::max( accumulated_weights[i] / normalized_weights[i] - .5, 0. );
+}
@@ -50,8 +50,6 @@ class ibl3 : public ibl {
     DataSet _conceptual_descriptor;
     int hit = 0;
     int miss = 0;
-    double accepting_threshold;
-    double rejecting_threshold;
     long long unsigned _seed;
 
     /* Dummy pointer used to handle the data to the method nearest_neighbor().
@@ -59,6 +57,18 @@ class ibl3 : public ibl {
     mutable std::unique_ptr<NearestNeighbor> nn;
 
 protected:
+    double accepting_threshold;
+    double rejecting_threshold;
+
+    /* Used to combine the results of several independent trainings.
+     * merge_start discards the current results,
+     * leaving an empty conceptual descriptor with the given header;
+     * merge appends the conceptual descriptor of the given instance
+     * to the current one and adds up the hit and miss counts.
+     */
+    void merge_start( const DataSet & header );
+    void merge( const ibl3 & );
+
     /* The purpose of these methods is to ease the implementation of IBL 4.
      * do_distance is called several times per classification and queries
      * the distance between two data entries.
@@ -72,6 +82,16 @@ protected:
      */
     virtual std::unique_ptr<DistanceCalculator> do_distance_calculator() const;
 
+    /* Per-attribute factors used by the spatial index of the training
+     * to bound do_distance from below.
+     * If w is the returned vector, do_distance(x, y) must be
+     * at least w[i] * |x.attribute(i) - y.attribute(i)| for every attribute i.
+     *
+     * The default implementation returns nullptr,
+     * which means every factor is 1.
+     */
+    virtual const std::vector<double> * do_attribute_weights() const;
+
     /* This function is called after every classification.
      * Parameters:
      *  current_entry: the just-classified entry.
@@ -111,10 +131,14 @@ class ibl4 : public ibl3 {
     std::vector<double> weights;
     std::vector<double> accumulated_weights;
     std::vector<double> normalized_weights;
+    unsigned _shards = 1;
+
+    void train_shards( const DataSet & );
 
 protected:
     virtual double do_distance( const DataEntry &, const DataEntry & ) const override;
     virtual std::unique_ptr<DistanceCalculator> do_distance_calculator() const override;
+    virtual const std::vector<double> * do_attribute_weights() const override;
     virtual void do_update_weights(
         const DataEntry & current_entry,
         const DataEntry & best_match,
@@ -123,6 +147,26 @@ protected:
 
 public:
     ibl4( double accepting_threshold = 0.9, double rejecting_threshold = 0.75 );
+
+    /* Sets/gets the number of shards used in the training.
+     *
+     * With more than one shard, the dataset is split into that many
+     * contiguous pieces, and each one is trained by an independent IBL 4
+     * (in parallel; see util/parallel.hpp).
+     * The shard s is seeded from the pair (seed(), s),
+     * so the result depends only on the seed and the number of shards,
+     * not on the number of threads.
+     * The shards are then merged in order: the weight statistics are added up,
+     * the conceptual descriptors are concatenated
+     * and the hit/miss counts are summed.
+     *
+     * Each shard only sees its own piece of the dataset,
+     * so this is not equivalent to the sequential training,
+     * which is used with a single shard (the default).
+     */
+    void shards( unsigned );
+    unsigned shards() const;
+
     virtual void train( const DataSet & ) override;
 };
 
@@ -0,0 +1,225 @@
+/* Implementation of kd_tree.h.
+ */
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "kd_tree.h"
+#include "pr/data_entry.h"
+
+constexpr std::size_t KDTree::npos;
+
+KDTree::KDTree( std::size_t dimension ) :
+    _dimension( dimension )
+{
+    if( dimension == 0 )
+        throw "A kd-tree needs at least one dimension.";
+}
+
+std::size_t KDTree::insert( const DataEntry & entry ) {
+    if( entry.attribute_count() != _dimension )
+        throw "Entry dimension incompatible with the kd-tree.";
+
+    std::size_t id = size();
+    points.insert( points.end(), entry.attributes().begin(), entry.attributes().end() );
+
+    /* Find the first empty block,
+     * moving the contents of the previous blocks to the carry.
+     */
+    std::vector< std::size_t > carry{ id };
+    std::size_t k = 0;
+    for( ; k < blocks.size() && !blocks[k].empty(); k++ ) {
+        carry.insert( carry.end(), blocks[k].begin(), blocks[k].end() );
+        blocks[k].clear();
+        smallest_id[k].clear();
+    }
+    if( k == blocks.size() ) {
+        blocks.emplace_back();
+        smallest_id.emplace_back();
+    }
+
+    blocks[k] = std::move( carry );
+    smallest_id[k].resize( blocks[k].size() );
+    build( k, 0, blocks[k].size(), 0 );
+    return id;
+}
+
+std::size_t KDTree::build( std::size_t k, std::size_t lo, std::size_t hi, unsigned depth ) {
+    if( lo >= hi )
+        return npos;
+
+    std::vector< std::size_t > & ids = blocks[k];
+    std::size_t mid = lo + (hi - lo) / 2;
+    unsigned axis = depth % _dimension;
+
+    std::nth_element( ids.begin() + lo, ids.begin() + mid, ids.begin() + hi,
+        [&]( std::size_t a, std::size_t b ) {
+            return point(a)[axis] < point(b)[axis];
+        }
+    );
+
+    std::size_t smallest = std::min( {
+        ids[mid],
+        build( k, lo, mid, depth + 1 ),
+        build( k, mid + 1, hi, depth + 1 )
+    } );
+    smallest_id[k][mid] = smallest;
+    return smallest;
+}
+
+struct KDTree::query {
+    const double * target;
+    std::size_t limit;
+    const Distance & distance;
+    const Filter & filter;
+    const std::vector< double > * scale;
+
+    // Used by search_nearest.
+    double best_distance;
+    std::size_t best_id;
+
+    // Used by search_within.
+    double radius;
+    const std::function< void(std::size_t) > * visit;
+
+    /* Lower bound on the distance from the target
+     * to any point in the other side of the splitting plane.
+     */
+    double plane_distance( double difference, unsigned axis ) const {
+        double bound = std::fabs( difference );
+        return scale == nullptr ? bound : bound * (*scale)[axis];
+    }
+
+    bool accepts( std::size_t id ) const {
+        return id < limit && (!filter || filter(id));
+    }
+};
+
+void KDTree::search_nearest(
+    query & q,
+    std::size_t k,
+    std::size_t lo,
+    std::size_t hi,
+    unsigned depth
+) const {
+    if( lo >= hi )
+        return;
+    std::size_t mid = lo + (hi - lo) / 2;
+    if( smallest_id[k][mid] >= q.limit )
+        return;
+
+    std::size_t id = blocks[k][mid];
+    if( q.accepts(id) ) {
+        double distance = q.distance( id );
+        if( distance < q.best_distance ||
+            (distance == q.best_distance && id < q.best_id) )
+        {
+            q.best_distance = distance;
+            q.best_id = id;
+        }
+    }
+
+    unsigned axis = depth % _dimension;
+    double difference = q.target[axis] - point(id)[axis];
+
+    /* Descend first in the side of the target;
+     * the other side only matters if the splitting plane
+     * is not farther than the best distance so far.
+     * (Equality must be explored because of the id tie-breaking.)
+     */
+    bool left_first = difference < 0;
+    search_nearest( q, k, left_first ? lo : mid + 1, left_first ? mid : hi, depth + 1 );
+    if( q.plane_distance(difference, axis) <= q.best_distance )
+        search_nearest( q, k, left_first ? mid + 1 : lo, left_first ? hi : mid, depth + 1 );
+}
+
+void KDTree::search_within(
+    query & q,
+    std::size_t k,
+    std::size_t lo,
+    std::size_t hi,
+    unsigned depth
+) const {
+    if( lo >= hi )
+        return;
+    std::size_t mid = lo + (hi - lo) / 2;
+
+    std::size_t id = blocks[k][mid];
+    if( q.accepts(id) && q.distance(id) <= q.radius )
+        (*q.visit)( id );
+
+    unsigned axis = depth % _dimension;
+    double difference = q.target[axis] - point(id)[axis];
+    bool plane_inside = q.plane_distance(difference, axis) <= q.radius;
+
+    if( difference < 0 || plane_inside )
+        search_within( q, k, lo, mid, depth + 1 );
+    if( difference >= 0 || plane_inside )
+        search_within( q, k, mid + 1, hi, depth + 1 );
+}
+
+std::size_t KDTree::nearest( const DataEntry & entry, std::size_t limit ) const {
+    if( entry.attribute_count() != _dimension )
+        throw "Entry dimension incompatible with the kd-tree.";
+
+    const double * target = entry.attributes().data();
+    Distance euclidean = [&]( std::size_t id ) {
+        // Same computation as EuclideanDistance::operator().
+        const double * p = point( id );
+        double sum = 0;
+        for( std::size_t i = 0; i < _dimension; i++ )
+            sum = std::fma( p[i] - target[i], p[i] - target[i], sum );
+        return std::sqrt( sum );
+    };
+    Filter everything;
+
+    query q{ target, std::min(limit, size()), euclidean, everything, nullptr,
+        DBL_MAX, npos, 0, nullptr };
+    for( std::size_t k = 0; k < blocks.size(); k++ )
+        search_nearest( q, k, 0, blocks[k].size(), 0 );
+    return q.best_id;
+}
+
+std::size_t KDTree::nearest(
+    const DataEntry & entry,
+    const Distance & distance,
+    const Filter & filter,
+    const std::vector< double > * scale
+) const {
+    if( entry.attribute_count() != _dimension )
+        throw "Entry dimension incompatible with the kd-tree.";
+
+    query q{ entry.attributes().data(), size(), distance, filter, scale,
+        DBL_MAX, npos, 0, nullptr };
+    for( std::size_t k = 0; k < blocks.size(); k++ )
+        search_nearest( q, k, 0, blocks[k].size(), 0 );
+    return q.best_id;
+}
+
+void KDTree::within(
+    const DataEntry & entry,
+    double radius,
+    const Distance & distance,
+    const Filter & filter,
+    const std::function< void(std::size_t) > & visit,
+    const std::vector< double > * scale
+) const {
+    if( entry.attribute_count() != _dimension )
+        throw "Entry dimension incompatible with the kd-tree.";
+
+    query q{ entry.attributes().data(), size(), distance, filter, scale,
+        DBL_MAX, npos, radius, &visit };
+    for( std::size_t k = 0; k < blocks.size(); k++ )
+        search_within( q, k, 0, blocks[k].size(), 0 );
+}
+
+const double * KDTree::point( std::size_t id ) const {
+    return points.data() + id * _dimension;
+}
+
+std::size_t KDTree::size() const {
+    return points.size() / _dimension;
+}
+
+std::size_t KDTree::dimension() const {
+    return _dimension;
+}
@@ -0,0 +1,134 @@
+#ifndef PR_KD_TREE_H
+#define PR_KD_TREE_H
+
+/* Spatial index for nearest neighbor queries
+ * over a set of points that only grows.
+ *
+ * The points are kept in a set of static kd-trees
+ * whose sizes are distinct powers of two
+ * (the "logarithmic method" of Bentley and Saxe).
+ * Inserting a point merges the trees of the smaller sizes
+ * into a new balanced tree, in the same way a binary counter
+ * propagates its carry; thus, insertion costs O(log² n) amortized,
+ * no tree is ever unbalanced regardless of the insertion order,
+ * and a query visits at most log n trees.
+ *
+ * Each point is identified by its insertion order:
+ * the first inserted point has id 0, the next has id 1, and so on.
+ */
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class DataEntry;
+
+class KDTree {
+    std::size_t _dimension;
+
+    // Coordinates of the point i lie in [i * _dimension, (i+1) * _dimension).
+    std::vector< double > points;
+
+    /* blocks[k] is either empty or contains the ids of an implicit kd-tree:
+     * the root of the range [lo, hi) is the middle element,
+     * the left subtree is [lo, mid) and the right subtree is (mid, hi).
+     * The splitting axis is the depth of the node modulo _dimension.
+     *
+     * smallest_id[k][i] is the smallest id of the subtree rooted at blocks[k][i].
+     */
+    std::vector< std::vector< std::size_t > > blocks;
+    std::vector< std::vector< std::size_t > > smallest_id;
+
+    std::size_t build( std::size_t block, std::size_t lo, std::size_t hi, unsigned depth );
+
+    struct query;
+    void search_nearest(
+        query &,
+        std::size_t block,
+        std::size_t lo,
+        std::size_t hi,
+        unsigned depth
+    ) const;
+    void search_within(
+        query &,
+        std::size_t block,
+        std::size_t lo,
+        std::size_t hi,
+        unsigned depth
+    ) const;
+
+public:
+    static constexpr std::size_t npos = -1;
+
+    /* Constructs an empty tree of points with the given number of coordinates.
+     */
+    explicit KDTree( std::size_t dimension );
+
+    /* Inserts the attributes of the entry in the tree
+     * and returns the id of the new point.
+     */
+    std::size_t insert( const DataEntry & );
+
+    /* Returns the id of the point closest to the given entry
+     * under the euclidean distance,
+     * considering only points whose id is smaller than `limit`.
+     * Ties are broken in favor of the smallest id.
+     *
+     * The distance is computed exactly as EuclideanDistance(0) does,
+     * so the result matches a linear scan with that calculator.
+     *
+     * Returns npos if no point satisfies the restriction.
+     */
+    std::size_t nearest( const DataEntry &, std::size_t limit = npos ) const;
+
+    /* Generic queries, for metrics other than the plain euclidean distance.
+     *
+     * `distance(id)` must return the exact distance between the query entry
+     * and the point `id`; the tree never computes distances by itself.
+     * It only assumes that, for every axis a,
+     *  distance(id) >= scale[a] * |entry.attribute(a) - point(id)[a]|,
+     * which is used to discard whole subtrees.
+     * (A null `scale` means every factor is 1;
+     * this holds for the euclidean distance,
+     * and the weighted euclidean distance holds with scale = the weights.)
+     *
+     * Points for which `filter(id)` returns false are ignored;
+     * an empty `filter` accepts every point.
+     * The filter is consulted before the distance is computed.
+     */
+    using Distance = std::function< double(std::size_t) >;
+    using Filter = std::function< bool(std::size_t) >;
+
+    /* Returns the id of the closest point that passes the filter,
+     * with ties broken in favor of the smallest id,
+     * or npos if no point passes the filter.
+     */
+    std::size_t nearest(
+        const DataEntry &,
+        const Distance & distance,
+        const Filter & filter,
+        const std::vector< double > * scale = nullptr
+    ) const;
+
+    /* Calls `visit(id)` for every point that passes the filter
+     * and whose distance is not greater than `radius`.
+     * The order of the calls is unspecified.
+     */
+    void within(
+        const DataEntry &,
+        double radius,
+        const Distance & distance,
+        const Filter & filter,
+        const std::function< void(std::size_t) > & visit,
+        const std::vector< double > * scale = nullptr
+    ) const;
+
+    /* Coordinates of the point with the given id.
+     */
+    const double * point( std::size_t id ) const;
+
+    std::size_t size() const;
+    std::size_t dimension() const;
+};
+
+#endif // PR_KD_TREE_H
@@ -11,10 +11,10 @@ void MahalanobisDistance::calibrate( const DataSet & dataset ) {
             mean[i] += entry.attribute(i);
 
     for( unsigned i = 0; i < dim; i++ )
-        mean[i] /= dataset.size() - 1;
+        mean[i] /= dataset.size();
 
     // mean[i] is the average of the attribute(i).
-    cv::Mat_<double> covariance(dim, dim);
+    cv::Mat_<double> covariance = cv::Mat_<double>::zeros(dim, dim);
     for( const auto & entry : dataset )
         for( unsigned i = 0; i < dim; i++ )
             for( unsigned j = 0; j < dim; j++ )
@@ -37,3 +37,26 @@ double MahalanobisDistance::operator()(
 
     return std::sqrt( val(0,0) );
 }
+
+cv::Mat_<double> MahalanobisDistance::whitening() const {
+    cv::Mat_<double> a = inverse_covariance;
+    int n = a.rows;
+    cv::Mat_<double> l = cv::Mat_<double>::zeros(n, n);
+
+    // Cholesky-Banachiewicz: a = l * l.t(), column by column.
+    for( int j = 0; j < n; j++ ) {
+        double pivot = a(j, j);
+        for( int k = 0; k < j; k++ )
+            pivot -= l(j, k) * l(j, k);
+        if( pivot <= 0 )
+            continue;
+        l(j, j) = std::sqrt( pivot );
+        for( int i = j + 1; i < n; i++ ) {
+            double sum = a(i, j);
+            for( int k = 0; k < j; k++ )
+                sum -= l(i, k) * l(j, k);
+            l(i, j) = sum / l(j, j);
+        }
+    }
+    return l.t();
+}
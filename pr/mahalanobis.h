@@ -15,6 +15,15 @@ public:
      */
     virtual double operator()( const DataEntry& m, const DataEntry& x ) const override;
     virtual void calibrate( const DataSet& ) override;
+
+    /* Returns the upper triangular matrix W such that
+     * the distance between m and x is the euclidean norm of W (x - m);
+     * that is, the transpose of the Cholesky factor of the inverse covariance.
+     *
+     * The inverse covariance is positive semidefinite;
+     * the rows of W whose pivot vanishes are left zero.
+     */
+    cv::Mat_<double> whitening() const;
 };
 
 #endif // PR_MAHALANOBIS_H
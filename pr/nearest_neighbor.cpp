@@ -1,15 +1,57 @@
 #include <algorithm>
+#include <cstdint>
 #include <map>
 #include "nearest_neighbor.h"
 #include "pr/data_entry.h"
 #include "pr/data_set.h"
 #include "pr/distance.h"
+#include "pr/grid_generator.h"
+#include "util/parallel.hpp"
+#include "util/stats.h"
+
+namespace {
+    util::stats::counter queries( "nearest_neighbor.queries" );
+    util::stats::counter raster_hits( "nearest_neighbor.raster_hits" );
+    util::stats::counter entries_scanned( "nearest_neighbor.entries_scanned" );
+    util::stats::counter distance_evaluations( "nearest_neighbor.distance_evaluations" );
+    // Neighbors beyond the first k that were needed to break ties.
+    util::stats::counter tie_break_extensions( "nearest_neighbor.tie_break_extensions" );
+    util::stats::phase rasterize_phase( "nearest_neighbor.rasterize" );
+} // anonymous namespace
+
+/* The cell (i_0, ..., i_{d-1}) is the box between the grid points
+ * i_a and i_a + 1 of each attribute a,
+ * and its linear index has the last attribute varying fastest.
+ */
+struct NearestNeighbor::raster_table {
+    std::vector< double > low;
+    std::vector< double > step;
+    unsigned density;
+
+    /* Index of an entry whose categories are the answer for every point
+     * of the cell, or -1 if the cell needs the exact search.
+     */
+    std::vector< std::int32_t > representative;
+
+    // Returns the index of the cell of the entry, or -1 if it is outside.
+    long cell( const DataEntry & entry ) const {
+        long index = 0;
+        for( std::size_t a = 0; a < low.size(); a++ ) {
+            double t = (entry.attribute(a) - low[a]) / step[a];
+            // Written so that NaNs also fall outside.
+            if( !(t >= 0 && t < density) )
+                return -1;
+            index = index * density + (long) t;
+        }
+        return index;
+    }
+};
 
 NearestNeighbor::NearestNeighbor(
     std::unique_ptr<DataSet> && dataset,
     std::unique_ptr<DistanceCalculator> && distance,
     std::size_t neighbors,
-    bool normelize
+    bool normalize
 ) :
     _dataset( std::move(dataset) ),
     _distance( std::move(distance) ),
@@ -27,18 +69,38 @@ const DataSet& NearestNeighbor::dataset() const {
 
 DataSet & NearestNeighbor::edit_dataset() {
     dirty = true;
+    raster.reset();
     return *_dataset;
 }
 
-std::vector< std::string > NearestNeighbor::classify( const DataEntry & target ) const {
+void NearestNeighbor::recalibrate() const {
     if( normalize && dirty ) {
         _distance->calibrate(*_dataset);
         dirty = false;
     }
+}
+
+std::vector< std::string > NearestNeighbor::classify( const DataEntry & target ) const {
+    recalibrate();
+    queries.add();
+
+    if( raster ) {
+        long cell = raster->cell( target );
+        if( cell >= 0 && raster->representative[cell] >= 0 ) {
+            raster_hits.add();
+            const DataEntry & entry = _dataset->begin()[raster->representative[cell]];
+            std::vector< std::string > categories( _dataset->category_count() );
+            for( unsigned j = 0; j < categories.size(); j++ )
+                categories[j] = entry.category(j);
+            return categories;
+        }
+    }
 
     std::vector< std::pair<double, const DataEntry *> > nearest;
     for( const DataEntry & entry : *_dataset )
         nearest.emplace_back( (*_distance)( entry, target ), &entry );
+    entries_scanned.add( _dataset->size() );
+    distance_evaluations.add( _dataset->size() );
 
     std::sort( nearest.begin(), nearest.end() );
 
@@ -130,7 +192,7 @@ std::vector< std::string > NearestNeighbor::classify( const DataEntry & target )
      * For odd N, one vote goes to any of the C-2 other categories,
      * so the maximum is (C-2)*floor(N/2).
      */
-    bool draws = true;
+    bool draws = std::find( categories.begin(), categories.end(), "" ) != categories.end();
     while( draws ) {
         draws = false;
         for( unsigned i = 0; i < _dataset->category_count(); ++i ) {
@@ -148,11 +210,144 @@ std::vector< std::string > NearestNeighbor::classify( const DataEntry & target )
             }
         }
         ++it;
+        tie_break_extensions.add();
     }
 
     return categories;
 }
 
+std::vector< std::pair< std::size_t, double > > NearestNeighbor::candidates(
+    const std::vector< double > & low,
+    const std::vector< double > & high,
+    const std::vector< std::size_t > & among
+) const {
+    recalibrate();
+    if( neighbors == 0 )
+        throw "There are no nearest neighbors to search for.";
+    if( among.size() < neighbors )
+        throw "Too few candidates to find the nearest neighbors.";
+
+    std::size_t dim = low.size();
+    DataEntry center( std::vector< double >( dim ), {} );
+    DataEntry corner( std::vector< double >( dim ), {} );
+    for( std::size_t a = 0; a < dim; a++ )
+        center.attribute(a) = (low[a] + high[a]) / 2;
+
+    double r = 0;
+    for( std::size_t mask = 0; mask < (std::size_t(1) << dim); mask++ ) {
+        for( std::size_t a = 0; a < dim; a++ )
+            corner.attribute(a) = (mask >> a) & 1 ? high[a] : low[a];
+        r = std::max( r, (*_distance)( center, corner ) );
+    }
+
+    const DataEntry * entries = _dataset->begin();
+    std::vector< double > distances( among.size() );
+    for( std::size_t i = 0; i < among.size(); i++ )
+        distances[i] = (*_distance)( entries[among[i]], center );
+    distance_evaluations.add( (std::size_t(1) << dim) + among.size() );
+
+    std::vector< double > sorted( distances );
+    std::nth_element( sorted.begin(), sorted.begin() + (neighbors - 1), sorted.end() );
+    // Small slack against rounding errors.
+    double limit = (sorted[neighbors - 1] + 2 * r) * (1 + 1e-9);
+
+    std::vector< std::pair< std::size_t, double > > remaining;
+    for( std::size_t i = 0; i < among.size(); i++ )
+        if( distances[i] <= limit )
+            remaining.emplace_back( among[i], distances[i] );
+    return remaining;
+}
+
+double NearestNeighbor::distance( const DataEntry & a, const DataEntry & b ) const {
+    recalibrate();
+    distance_evaluations.add();
+    return (*_distance)( a, b );
+}
+
+std::size_t NearestNeighbor::neighbor_count() const {
+    return neighbors;
+}
+
+void NearestNeighbor::rasterize( unsigned density, double expand ) {
+    util::stats::timer timer( rasterize_phase );
+    raster.reset();
+    recalibrate();
+    const DataSet & dataset = *_dataset;
+    std::size_t dim = dataset.attribute_count();
+    if( dim > 8 )
+        throw "Too many attributes to rasterize the classifier.";
+    std::size_t cells = 1;
+    for( std::size_t a = 0; a < dim; a++ ) {
+        cells *= density;
+        if( cells > (1u << 28) )
+            throw "Too many cells to rasterize the classifier.";
+    }
+    if( dataset.size() > 0x7fffffff )
+        throw "Too many entries to rasterize the classifier.";
+    if( density == 0 || neighbors == 0 || dataset.size() < neighbors )
+        return;
+
+    GridGenerator grid;
+    grid.expand( expand );
+    grid.density( std::vector< unsigned >( dim, density ) );
+    grid.calibrate( dataset );
+
+    auto table = std::make_unique< raster_table >();
+    table->density = density;
+    for( std::size_t a = 0; a < dim; a++ ) {
+        table->low.push_back( grid.coordinate( a, 0 ) );
+        table->step.push_back( grid.coordinate( a, 1 ) - grid.coordinate( a, 0 ) );
+    }
+    table->representative.resize( cells );
+
+    /* If the candidates of a cell agree in every category type,
+     * so do the votes for every point of the cell.
+     */
+    const DataEntry * entries = dataset.begin();
+    std::size_t categories = dataset.category_count();
+    std::vector< std::size_t > all( dataset.size() );
+    for( std::size_t i = 0; i < all.size(); i++ )
+        all[i] = i;
+    util::parallel_blocks( 0, cells, 64, [&]( std::size_t begin, std::size_t end ) {
+        std::vector< double > low( dim ), high( dim );
+
+        for( std::size_t cell = begin; cell < end; cell++ ) {
+            std::size_t rest = cell;
+            for( std::size_t a = dim; a-- > 0; ) {
+                unsigned index = rest % density;
+                rest /= density;
+                low[a] = grid.coordinate( a, index );
+                high[a] = grid.coordinate( a, index + 1 );
+            }
+
+            auto remaining = candidates( low, high, all );
+            // Nothing remains only if some distance is NaN.
+            if( remaining.empty() ) {
+                table->representative[cell] = -1;
+                continue;
+            }
+            std::size_t first = remaining[0].first;
+            bool agree = true;
+            for( std::size_t i = 1; i < remaining.size() && agree; i++ )
+                for( std::size_t j = 0; j < categories; j++ )
+                    if( entries[remaining[i].first].category(j) != entries[first].category(j) )
+                        agree = false;
+            table->representative[cell] = agree ? (std::int32_t) first : -1;
+        }
+    });
+    raster = std::move( table );
+}
+
+double NearestNeighbor::raster_coverage() const {
+    if( !raster || raster->representative.empty() )
+        return 0;
+    std::size_t covered = std::count_if(
+        raster->representative.begin(), raster->representative.end(),
+        []( std::int32_t r ) { return r >= 0; }
+    );
+    return (double) covered / raster->representative.size();
+}
+
 /* The destructor must be here because std::unique_ptr's default destructor
  * requires the full class specification.
  * This would defeat the purpose of the forward-declarations
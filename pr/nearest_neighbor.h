@@ -3,6 +3,7 @@
 
 #include <string>
 #include <memory>
+#include <utility>
 #include <vector>
 
 class DataSet;
@@ -16,6 +17,10 @@ class NearestNeighbor {
     bool normalize;
     mutable bool dirty;
 
+    // Lookup table built by rasterize(); null if there is none.
+    struct raster_table;
+    std::unique_ptr<raster_table> raster;
+
 public:
     NearestNeighbor(
         std::unique_ptr<DataSet> && dataset,
@@ -30,11 +35,74 @@ public:
      * The second returns a modifiable reference,
      * but the next data entry classification will trigger a (potentially costly)
      * recalibration of the distance calculator.
+     * It also discards the table built by rasterize().
      */
     const DataSet & dataset() const;
     DataSet & edit_dataset();
 
+    /* Recalibrates the distance calculator
+     * if the dataset was changed through edit_dataset().
+     *
+     * classify() does this on demand,
+     * so it modifies the classifier in the first call after an edition.
+     * Thus, classify() may only be called concurrently after recalibrate().
+     */
+    void recalibrate() const;
+
     std::vector< std::string > classify( const DataEntry & ) const;
+
+    /* Precomputes the answers of classify() over a bounded region,
+     * so that most queries cost a single table lookup.
+     *
+     * The region is the box of the dataset, enlarged by `expand`
+     * (as in GridGenerator), and it is divided in `density` cells
+     * per attribute. For each cell, the entries that may be
+     * among the nearest neighbors of some point of the cell are found
+     * by candidates();
+     * if all of them have the same categories, the cell is stored
+     * with these categories. The other cells, which straddle
+     * a decision boundary, and the queries outside the region,
+     * fall back to the exact search. Thus, the answers are unchanged.
+     *
+     * The table has density^attribute_count() cells,
+     * each costing a pass over the dataset to build (in parallel;
+     * see util/parallel.hpp), so this is meant for few attributes.
+     * Throws if there are more than 8 attributes or 2^28 cells.
+     */
+    void rasterize( unsigned density, double expand = 0.05 );
+
+    /* Fraction of the cells of the table that answer queries by themselves,
+     * or zero if there is no table.
+     */
+    double raster_coverage() const;
+
+    /* Entries that may be among the nearest neighbors of some point
+     * of the box between `low` and `high` (one value per attribute).
+     *
+     * Let c be the center of the box and r the distance from c
+     * to its farthest corner; every point p of the box is within r of c.
+     * If d is the distance from c to its k-th nearest candidate,
+     * p has k candidates within d + r, so, by the triangle inequality,
+     * no candidate farther than d + 2r from c is among the neighbors of p.
+     *
+     * Only the entries listed in `among` (indices into dataset())
+     * are candidates; throws if there are fewer than neighbor_count().
+     * The remaining ones are returned in the same order,
+     * each with its distance to c.
+     */
+    std::vector< std::pair< std::size_t, double > > candidates(
+        const std::vector< double > & low,
+        const std::vector< double > & high,
+        const std::vector< std::size_t > & among
+    ) const;
+
+    /* Distance between the entries, as measured by the classifier;
+     * that is, after the recalibration, if needed.
+     */
+    double distance( const DataEntry &, const DataEntry & ) const;
+
+    // Number of neighbors that vote in classify().
+    std::size_t neighbor_count() const;
 };
 
 #endif // NEAREST_NEIGHBOR_H
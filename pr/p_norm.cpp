@@ -22,6 +22,11 @@ double NormalizingDistanceCalculator::normalize( double value, std::size_t index
     return multiplicative_factor[index] * (value - minimum_value[index]);
 };
 
+double NormalizingDistanceCalculator::scale( std::size_t index ) const {
+    if( !normalized ) return 1;
+    return multiplicative_factor[index];
+}
+
 
 EuclideanDistance::EuclideanDistance( double normalizing_tolerance ) :
     NormalizingDistanceCalculator( normalizing_tolerance )
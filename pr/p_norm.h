@@ -30,6 +30,12 @@ protected:
     double normalize( double value, std::size_t attribute_index ) const;
 public:
 
+    /* Factor that normalize() applies to the differences of the given attribute;
+     * that is, normalize(a, i) - normalize(b, i) == scale(i) * (a - b).
+     * Returns 1 if the calculator was not calibrated.
+     */
+    double scale( std::size_t attribute_index ) const;
+
     /* Construct the "normalization engine" with the given tolerance.
      *
      * Suppose that the values of some dimension lies in the interval [min,max].
@@ -0,0 +1,148 @@
+/* Implementation of synthetic.h.
+ */
+#include <cmath>
+#include <limits>
+#include "synthetic.h"
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+
+namespace {
+    // The finalizer of SplitMix64; a bijection with good avalanche.
+    std::uint64_t mix( std::uint64_t x ) {
+        x += 0x9e3779b97f4a7c15;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+        return x ^ (x >> 31);
+    }
+
+    const double pi = 3.14159265358979323846;
+
+    /* Streams of random numbers of each entry.
+     * Each attribute a uses the streams attribute_stream + 2a and the next one.
+     */
+    const std::uint64_t noise_stream = 0;
+    const std::uint64_t noisy_class_stream = 1;
+    const std::uint64_t class_stream = 2;
+    const std::uint64_t position_stream = 3;
+    const std::uint64_t attribute_stream = 4;
+
+    // Index of the "entries" that give the centers; never a real entry.
+    const std::uint64_t center_index = std::numeric_limits< std::uint64_t >::max();
+} // anonymous namespace
+
+double SyntheticDataset::random( std::uint64_t index, std::uint64_t stream ) const {
+    std::uint64_t bits = mix( mix( mix( seed ) ^ index ) + stream );
+    return (bits >> 11) * (1.0 / (std::uint64_t(1) << 53));
+}
+
+double SyntheticDataset::normal( std::uint64_t index, std::uint64_t stream ) const {
+    // Box-Muller; 1 - u is in (0, 1], so the logarithm is finite.
+    double u = random( index, stream );
+    double v = random( index, stream + 1 );
+    return std::sqrt( -2 * std::log( 1 - u ) ) * std::cos( 2 * pi * v );
+}
+
+SyntheticDataset::SyntheticDataset(
+    shape_type shape,
+    std::size_t attribute_count,
+    unsigned class_count,
+    double label_noise,
+    std::uint64_t seed
+) :
+    shape( shape ),
+    attributes( attribute_count ),
+    classes( class_count ),
+    label_noise( label_noise ),
+    seed( seed )
+{
+    if( attributes == 0 )
+        throw "A synthetic dataset needs at least one attribute.";
+    if( classes == 0 )
+        throw "A synthetic dataset needs at least one class.";
+    if( !(label_noise >= 0 && label_noise <= 1) )
+        throw "The label noise must be in [0, 1].";
+    if( shape == spiral && attributes < 2 )
+        throw "Spirals need at least two attributes.";
+
+    for( unsigned c = 0; c < classes; c++ )
+        for( std::size_t a = 0; a < attributes; a++ )
+            centers.push_back( 10 * random( center_index, c * attributes + a ) );
+}
+
+unsigned SyntheticDataset::generate( std::uint64_t index, double * output ) const {
+    unsigned c = 0;
+    switch( shape ) {
+        case gaussian:
+            c = random( index, class_stream ) * classes;
+            for( std::size_t a = 0; a < attributes; a++ )
+                output[a] = centers[c * attributes + a]
+                    + normal( index, attribute_stream + 2*a );
+            break;
+
+        case uniform: {
+            for( std::size_t a = 0; a < attributes; a++ )
+                output[a] = 10 * random( index, attribute_stream + 2*a );
+            double nearest = std::numeric_limits< double >::infinity();
+            for( unsigned k = 0; k < classes; k++ ) {
+                double distance = 0;
+                for( std::size_t a = 0; a < attributes; a++ ) {
+                    double d = output[a] - centers[k * attributes + a];
+                    distance += d * d;
+                }
+                if( distance < nearest ) {
+                    nearest = distance;
+                    c = k;
+                }
+            }
+            break;
+        }
+
+        case spiral: {
+            /* Two turns, from radius 1 to 9, around (10, 10);
+             * the radius has gaussian noise.
+             */
+            c = random( index, class_stream ) * classes;
+            double t = random( index, position_stream );
+            double angle = c * 2 * pi / classes + 4 * pi * t;
+            double radius = 1 + 8 * t + 0.2 * normal( index, attribute_stream );
+            output[0] = 10 + radius * std::cos( angle );
+            output[1] = 10 + radius * std::sin( angle );
+            for( std::size_t a = 2; a < attributes; a++ )
+                output[a] = normal( index, attribute_stream + 2*a );
+            break;
+        }
+    }
+
+    if( label_noise > 0 && random( index, noise_stream ) < label_noise )
+        c = random( index, noisy_class_stream ) * classes;
+    return c;
+}
+
+DataEntry SyntheticDataset::entry( std::uint64_t index ) const {
+    std::vector< double > values( attributes );
+    unsigned c = generate( index, values.data() );
+    return DataEntry( std::move(values), {class_name(c)} );
+}
+
+DataSet SyntheticDataset::dataset( std::size_t size ) const {
+    std::vector< std::string > attribute_names;
+    for( std::size_t a = 0; a < attributes; a++ )
+        attribute_names.push_back( "x" + std::to_string(a) );
+    std::vector< DataEntry > entries;
+    entries.reserve( size );
+    for( std::size_t i = 0; i < size; i++ )
+        entries.push_back( entry(i) );
+    return DataSet( std::move(attribute_names), {"class"}, std::move(entries) );
+}
+
+std::string SyntheticDataset::class_name( unsigned c ) {
+    return "c" + std::to_string( c );
+}
+
+std::size_t SyntheticDataset::attribute_count() const {
+    return attributes;
+}
+
+unsigned SyntheticDataset::class_count() const {
+    return classes;
+}
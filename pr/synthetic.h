@@ -0,0 +1,90 @@
+#ifndef PR_SYNTHETIC_H
+#define PR_SYNTHETIC_H
+
+/* Synthetic datasets of any size, for tests and load tests.
+ *
+ * Every entry is a function only of the seed, the parameters and its index,
+ * computed by a counter-based random number generator;
+ * so the entries can be generated in any order, by any number of threads,
+ * and the same seed always gives the same dataset.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+class DataEntry;
+class DataSet;
+
+class SyntheticDataset {
+public:
+    enum shape_type {
+        /* One gaussian blob, with unit variance, per class;
+         * the centers are uniformly drawn from [0, 10]^d.
+         */
+        gaussian,
+
+        /* Uniform over [0, 10]^d;
+         * the class is the nearest of one random center per class.
+         */
+        uniform,
+
+        /* One spiral per class in the first two attributes,
+         * with the start angles evenly spaced (as in generate_spiral);
+         * the other attributes are gaussian noise.
+         */
+        spiral,
+    };
+
+private:
+    shape_type shape;
+    std::size_t attributes;
+    unsigned classes;
+    double label_noise;
+    std::uint64_t seed;
+
+    // The center of the class c is centers[c * attributes, (c+1) * attributes).
+    std::vector< double > centers;
+
+    // Uniform in [0, 1) and standard normal numbers, for each (index, stream).
+    double random( std::uint64_t index, std::uint64_t stream ) const;
+    double normal( std::uint64_t index, std::uint64_t stream ) const;
+
+public:
+    /* With probability label_noise, the class of an entry is replaced
+     * by a class chosen uniformly at random (possibly the same).
+     *
+     * Throws if there are no attributes or classes,
+     * if label_noise is not in [0, 1],
+     * or if a spiral has less than two attributes.
+     */
+    SyntheticDataset(
+        shape_type shape,
+        std::size_t attribute_count,
+        unsigned class_count,
+        double label_noise,
+        std::uint64_t seed
+    );
+
+    /* Writes the attribute_count() attributes of the entry to `attributes`
+     * and returns its class, in [0, class_count()).
+     */
+    unsigned generate( std::uint64_t index, double * attributes ) const;
+
+    /* Returns the entry, with a single category, named by class_name().
+     */
+    DataEntry entry( std::uint64_t index ) const;
+
+    /* Returns the dataset with the entries [0, size),
+     * named as the text output of datatools/generate_dataset.
+     */
+    DataSet dataset( std::size_t size ) const;
+
+    // "c0", "c1", and so on.
+    static std::string class_name( unsigned );
+
+    std::size_t attribute_count() const;
+    unsigned class_count() const;
+};
+
+#endif // PR_SYNTHETIC_H
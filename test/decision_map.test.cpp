@@ -0,0 +1,72 @@
+#include "pr/decision_map.h"
+#include <catch.hpp>
+
+#include "pr/data_set.h"
+#include "pr/data_entry.h"
+#include "pr/nearest_neighbor.h"
+#include "pr/p_norm.h"
+
+TEST_CASE( "Decision maps", "[decision_map]" ) {
+    std::unique_ptr<DataSet> dataset( new DataSet( 3, 1 ) );
+    dataset->push_back( DataEntry( {0, 0, 0}, {"A"} ) );
+    dataset->push_back( DataEntry( {1, 0, 5}, {"B"} ) );
+    dataset->push_back( DataEntry( {0, 1, 2}, {"C"} ) );
+    dataset->push_back( DataEntry( {1, 1, 9}, {"A"} ) );
+    std::unique_ptr<DistanceCalculator> distance( new EuclideanDistance(0) );
+    NearestNeighbor nn( std::move(dataset), std::move(distance), 1 );
+
+    DecisionMap map = evaluate_decision_map( nn, {{2, 4.0}}, 6, 0.1 );
+
+    REQUIRE( map.axes.size() == 2 );
+    CHECK( map.axes[0].attribute == 0 );
+    CHECK( map.axes[1].attribute == 1 );
+    CHECK( map.axes[0].points == 7 );
+    CHECK( map.categories == (std::vector< std::string >{"A", "B", "C"}) );
+    REQUIRE( map.labels.size() == 7 * 7 );
+
+    SECTION( "Labels" ) {
+        for( unsigned i = 0; i < 7; i++ )
+            for( unsigned j = 0; j < 7; j++ ) {
+                DataEntry query( {
+                    map.axes[0].first + i * map.axes[0].step,
+                    map.axes[1].first + j * map.axes[1].step,
+                    4.0
+                }, {} );
+                CHECK( map.categories[map.labels[7*i + j]] == nn.classify( query )[0] );
+            }
+    }
+
+    SECTION( "Files" ) {
+        for( bool run_length : {false, true} ) {
+            std::FILE * file = std::tmpfile();
+            write_decision_map( file, map, run_length );
+            std::rewind( file );
+            DecisionMap read = read_decision_map( file );
+            std::fclose( file );
+
+            REQUIRE( read.axes.size() == 2 );
+            for( int i = 0; i < 2; i++ ) {
+                CHECK( read.axes[i].attribute == map.axes[i].attribute );
+                CHECK( read.axes[i].points == map.axes[i].points );
+                CHECK( read.axes[i].first == map.axes[i].first );
+                CHECK( read.axes[i].step == map.axes[i].step );
+            }
+            REQUIRE( read.fixed.size() == 1 );
+            CHECK( read.fixed[0].attribute == 2 );
+            CHECK( read.fixed[0].value == 4.0 );
+            CHECK( read.categories == map.categories );
+            CHECK( read.labels == map.labels );
+        }
+    }
+
+    SECTION( "Errors" ) {
+        CHECK_THROWS( evaluate_decision_map( nn, {{3, 0.0}}, 6, 0.1 ) );
+        CHECK_THROWS( evaluate_decision_map( nn, {{1, 0.0}, {1, 2.0}}, 6, 0.1 ) );
+
+        std::FILE * file = std::tmpfile();
+        std::fputs( "DMAX", file );
+        std::rewind( file );
+        CHECK_THROWS( read_decision_map( file ) );
+        std::fclose( file );
+    }
+}
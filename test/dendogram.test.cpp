@@ -1,8 +1,19 @@
 #include "pr/dendogram.h"
 #include "pr/dendogram_node.h"
+#include "pr/distance_matrix.h"
 #include "pr/data_set.h"
 #include "pr/data_entry.h"
 #include <catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+#include "pr/p_norm.h"
+#include "util/parallel.hpp"
 
 TEST_CASE( "DendogramIterator", "[dendogram]" ) {
     DataEntry d1({},{},"1");
@@ -10,73 +21,119 @@ TEST_CASE( "DendogramIterator", "[dendogram]" ) {
     DataEntry d3({},{},"3");
     DataEntry d4({},{},"4");
     DataEntry d5({},{},"5");
+    Dendogram dendogram( std::vector<const DataEntry *>{&d1, &d2, &d3, &d4, &d5} );
+    CHECK( !dendogram.complete() );
+    CHECK( dendogram.leaf_order().empty() );
+    CHECK_THROWS( dendogram.root() );
 
     // Terminals
-    auto nt1 = std::make_unique<DendogramNode>( &d1 );
-    auto nt2 = std::make_unique<DendogramNode>( &d2 );
-    auto nt3 = std::make_unique<DendogramNode>( &d3 );
-    auto nt4 = std::make_unique<DendogramNode>( &d4 );
-    auto nt5 = std::make_unique<DendogramNode>( &d5 );
-    CHECK( nt1->size() == 1 );
-    CHECK( nt2->size() == 1 );
-    CHECK( nt3->size() == 1 );
-    CHECK( nt4->size() == 1 );
-    CHECK( nt5->size() == 1 );
-
-    CHECK( nt1->depth() == 0 );
-    CHECK( nt2->depth() == 0 );
-    CHECK( nt3->depth() == 0 );
-    CHECK( nt4->depth() == 0 );
-    CHECK( nt5->depth() == 0 );
+    auto nt1 = dendogram.leaf( 0 );
+    auto nt2 = dendogram.leaf( 1 );
+    auto nt3 = dendogram.leaf( 2 );
+    auto nt4 = dendogram.leaf( 3 );
+    auto nt5 = dendogram.leaf( 4 );
+    CHECK( nt1.size() == 1 );
+    CHECK( nt2.size() == 1 );
+    CHECK( nt3.size() == 1 );
+    CHECK( nt4.size() == 1 );
+    CHECK( nt5.size() == 1 );
+
+    CHECK( nt1.depth() == 0 );
+    CHECK( nt2.depth() == 0 );
+    CHECK( nt3.depth() == 0 );
+    CHECK( nt4.depth() == 0 );
+    CHECK( nt5.depth() == 0 );
+    CHECK( nt3.data() == d3 );
+    CHECK( *nt3.begin() == d3 );
 
     // Second level
-    auto ns1 = std::make_unique<DendogramNode>( std::move(nt1), std::move(nt2), 0.0 );
-    auto ns2 = std::make_unique<DendogramNode>( std::move(nt4), std::move(nt5), 0.0 );
-    CHECK( ns1->size() == 2 );
-    CHECK( ns2->size() == 2 );
-    CHECK( ns1->depth() == 1 );
-    CHECK( ns2->depth() == 1 );
+    auto ns1 = dendogram.merge( nt1, nt2, 0.0 );
+    auto ns2 = dendogram.merge( nt4, nt5, 0.0 );
+    CHECK( ns1.size() == 2 );
+    CHECK( ns2.size() == 2 );
+    CHECK( ns1.depth() == 1 );
+    CHECK( ns2.depth() == 1 );
+    CHECK( ns1.id() == 5 );
+    CHECK( nt1.parent() == ns1 );
+    CHECK( !ns1.has_parent() );
+    CHECK_THROWS( dendogram.merge( nt1, nt3, 0.0 ) );
+    CHECK_THROWS( dendogram.merge( ns1, ns1, 0.0 ) );
 
     // Third level
-    auto nt = std::make_unique<DendogramNode>( std::move(ns1), std::move(nt3), 0.0 );
-    CHECK( nt->size() == 3 );
-    CHECK( nt->depth() == 2 );
+    auto nt = dendogram.merge( ns1, nt3, 0.0 );
+    CHECK( nt.size() == 3 );
+    CHECK( nt.depth() == 2 );
 
     // Top-level
-    auto top = std::make_unique<DendogramNode>( std::move(nt), std::move(ns2), 0.0 );
-    CHECK( top->size() == 5 );
-    CHECK( top->depth() == 3 );
+    auto top = dendogram.merge( nt, ns2, 0.0 );
+    CHECK( top.size() == 5 );
+    CHECK( top.depth() == 3 );
+    REQUIRE( dendogram.complete() );
+    CHECK( dendogram.root() == top );
 
-    auto it = top->begin();
+    auto it = top.begin();
     CHECK( *it == d1 );
-    REQUIRE( it != top->end() );
+    REQUIRE( it != top.end() );
     ++it;
     CHECK( *it == d2 );
-    REQUIRE( it != top->end() );
+    REQUIRE( it != top.end() );
     ++it;
     CHECK( *it == d3 );
-    REQUIRE( it != top->end() );
+    REQUIRE( it != top.end() );
     ++it;
     CHECK( *it == d4 );
-    REQUIRE( it != top->end() );
+    REQUIRE( it != top.end() );
     ++it;
     CHECK( *it == d5 );
-    REQUIRE( it != top->end() );
+    REQUIRE( it != top.end() );
     ++it;
-    CHECK( it == top->end() );
+    CHECK( it == top.end() );
 
     // In itarating through the left node, we should pass through d1, d2 and d3.
-    auto subit = top->left().begin();
+    auto subit = top.left().begin();
     CHECK( *subit == d1 );
-    REQUIRE( subit != top->left().end() );
+    REQUIRE( subit != top.left().end() );
     ++subit;
     CHECK( *subit == d2 );
-    REQUIRE( subit != top->left().end() );
+    REQUIRE( subit != top.left().end() );
     ++subit;
     CHECK( *subit == d3 );
-    REQUIRE( subit != top->left().end() );
+    REQUIRE( subit != top.left().end() );
     ++subit;
-    CHECK( subit == top->left().end() );
+    CHECK( subit == top.left().end() );
+
+    // The leaves of each node are contiguous in the leaf order.
+    CHECK( dendogram.leaf_order() == (std::vector<std::size_t>{0, 1, 2, 3, 4}) );
+    CHECK( top.leaf_offset() == 0 );
+    CHECK( nt3.leaf_offset() == 2 );
+    CHECK( ns2.leaf_offset() == 3 );
+}
+
+TEST_CASE( "Leaf order of a dendogram", "[dendogram]" ) {
+    std::vector<DataEntry> entries;
+    for( int i = 0; i < 6; i++ )
+        entries.push_back( DataEntry({}, {}, std::to_string(i)) );
+    std::vector<const DataEntry *> pointers;
+    for( const auto & entry : entries )
+        pointers.push_back( &entry );
+
+    Dendogram dendogram( pointers );
+    auto a = dendogram.merge( dendogram.leaf(4), dendogram.leaf(1), 1 );
+    auto b = dendogram.merge( dendogram.leaf(0), dendogram.leaf(5), 2 );
+    auto c = dendogram.merge( b, dendogram.leaf(3), 3 );
+    auto d = dendogram.merge( dendogram.leaf(2), a, 4 );
+    auto root = dendogram.merge( d, c, 5 );
+
+    const auto & order = dendogram.leaf_order();
+    REQUIRE( order == (std::vector<std::size_t>{2, 4, 1, 0, 5, 3}) );
+    for( DendogramNode node : {a, b, c, d, root} ) {
+        std::vector<std::string> names;
+        for( const auto & entry : node )
+            names.push_back( entry.name() );
+        REQUIRE( names.size() == node.size() );
+        for( std::size_t i = 0; i < node.size(); i++ )
+            CHECK( names[i] == std::to_string( order[node.leaf_offset() + i] ) );
+    }
 }
 
 TEST_CASE( "Dendogram builder", "[dendogram]" ) {
@@ -91,7 +148,8 @@ TEST_CASE( "Dendogram builder", "[dendogram]" ) {
             DataEntry({1, 4}, {}, "E"),
         }
     );
-    auto dendogram = generate_dendogram( dataset, SimpleLinkage, SimpleLinkageUpdate );
+    Dendogram tree = generate_dendogram( dataset, SimpleLinkage, SimpleLinkageUpdate );
+    DendogramNode dendogram = tree.root();
     /* Structure:       dendogram
      *                  /       \
      *               left      right
@@ -101,11 +159,11 @@ TEST_CASE( "Dendogram builder", "[dendogram]" ) {
      *           E        A    B    C    D
      */
 
-    REQUIRE( dendogram->structural() );
-    const DendogramNode & left = dendogram->begin()->name() == "E" ?
-        dendogram->left() : dendogram->right();
-    const DendogramNode & right = dendogram->begin()->name() != "E" ?
-        dendogram->left() : dendogram->right();
+    REQUIRE( dendogram.structural() );
+    DendogramNode left = dendogram.begin()->name() == "E" ?
+        dendogram.left() : dendogram.right();
+    DendogramNode right = dendogram.begin()->name() != "E" ?
+        dendogram.left() : dendogram.right();
 
     SECTION( "Analysis of node `left`" ) {
         REQUIRE( left.leaf() );
@@ -114,14 +172,14 @@ TEST_CASE( "Dendogram builder", "[dendogram]" ) {
     SECTION( "Analysis of node `right`" ) {
         REQUIRE( right.structural() );
         bool child1_left = right.begin()->name() == "A" || right.begin()->name() == "B";
-        const DendogramNode & child1 = child1_left ? right.left() : right.right();
-        const DendogramNode & child2 = !child1_left ? right.left() : right.right();
+        DendogramNode child1 = child1_left ? right.left() : right.right();
+        DendogramNode child2 = !child1_left ? right.left() : right.right();
 
         SECTION( "Analysis of node `child1`" ) {
             REQUIRE( child1.structural() );
-            const DendogramNode & a = child1.begin()->name() == "A" ?
+            DendogramNode a = child1.begin()->name() == "A" ?
                 child1.left() : child1.right();
-            const DendogramNode & b = child1.begin()->name() != "A" ?
+            DendogramNode b = child1.begin()->name() != "A" ?
                 child1.left() : child1.right();
             REQUIRE( a.leaf() );
             CHECK( a.data().name() == "A" );
@@ -131,9 +189,9 @@ TEST_CASE( "Dendogram builder", "[dendogram]" ) {
 
         SECTION( "Analysis of node `child2`" ) {
             REQUIRE( child2.structural() );
-            const DendogramNode & c = child2.begin()->name() == "C" ?
+            DendogramNode c = child2.begin()->name() == "C" ?
                 child2.left() : child2.right();
-            const DendogramNode & d = child2.begin()->name() != "C" ?
+            DendogramNode d = child2.begin()->name() != "C" ?
                 child2.left() : child2.right();
             REQUIRE( c.leaf() );
             CHECK( c.data().name() == "C" );
@@ -142,3 +200,376 @@ TEST_CASE( "Dendogram builder", "[dendogram]" ) {
         }
     }
 }
+
+namespace {
+    /* An unused file name, in a new temporary directory.
+     * The file (if created) and the directory are removed on destruction.
+     */
+    struct temporary_path {
+        std::string directory;
+        std::string path;
+
+        temporary_path() {
+            char name[] = "/tmp/dendogram.test.XXXXXX";
+            REQUIRE( mkdtemp( name ) != nullptr );
+            directory = name;
+            path = directory + "/matrix";
+        }
+        ~temporary_path() {
+            unlink( path.c_str() );
+            rmdir( directory.c_str() );
+        }
+    };
+} // anonymous namespace
+
+TEST_CASE( "Condensed distance matrix", "[dendogram]" ) {
+    auto check = []( const DistanceStorage & storage ) {
+        DistanceMatrix matrix( 5, storage );
+        REQUIRE( matrix.size() == 5 );
+        for( std::size_t i = 0; i < 5; i++ )
+            for( std::size_t j = i + 1; j < 5; j++ )
+                matrix.set( i, j, 10 * i + j );
+
+        double row[4];
+        for( std::size_t i = 0; i < 5; i++ ) {
+            matrix.get_row( i, row );
+            for( std::size_t j = i + 1; j < 5; j++ ) {
+                CHECK( matrix(i, j) == 10 * i + j );
+                CHECK( matrix(j, i) == 10 * i + j );
+                CHECK( row[j - i - 1] == 10 * i + j );
+            }
+        }
+
+        DistanceMatrix moved = std::move( matrix );
+        CHECK( moved(1, 3) == 13 );
+        double input[] = {0.5, 1.5, 2.5};
+        moved.set_row( 1, input );
+        CHECK( moved(3, 1) == 1.5 );
+    };
+
+    SECTION( "In memory" ) {
+        check( {} );
+    }
+    SECTION( "Single precision" ) {
+        check( {true, ""} );
+        DistanceMatrix matrix( 2, {true, ""} );
+        matrix.set( 0, 1, 0.1 );
+        CHECK( matrix(0, 1) == (float) 0.1 );
+    }
+    SECTION( "Memory-mapped file" ) {
+        temporary_path temporary;
+        check( {false, temporary.path} );
+        check( {true, temporary.path} );
+        // The file is removed as soon as it is mapped.
+        std::FILE * file = std::fopen( temporary.path.c_str(), "r" );
+        bool exists = file != nullptr;
+        if( file != nullptr )
+            std::fclose( file );
+        CHECK( !exists );
+    }
+    SECTION( "Existing files are not overwritten" ) {
+        temporary_path temporary;
+        std::FILE * file = std::fopen( temporary.path.c_str(), "w" );
+        REQUIRE( file != nullptr );
+        std::fputs( "precious", file );
+        std::fclose( file );
+
+        CHECK_THROWS( DistanceMatrix( 5, {false, temporary.path} ) );
+
+        char contents[16] = {};
+        file = std::fopen( temporary.path.c_str(), "r" );
+        REQUIRE( file != nullptr );
+        std::fread( contents, 1, sizeof(contents) - 1, file );
+        std::fclose( file );
+        CHECK( std::string( contents ) == "precious" );
+    }
+}
+
+namespace {
+    /* Heights of the merges of the dendogram, in increasing order.
+     */
+    void merge_heights( const DendogramNode & node, std::vector<double> & heights ) {
+        if( node.leaf() )
+            return;
+        heights.push_back( node.linkage_distance() );
+        merge_heights( node.left(), heights );
+        merge_heights( node.right(), heights );
+    }
+
+    /* Textbook agglomerative clustering:
+     * recomputes every linkage distance from scratch in each step.
+     */
+    std::vector<double> naive_merge_heights(
+        const DataSet & dataset,
+        LinkageDistanceFunction linkage
+    ) {
+        Dendogram dendogram( dataset );
+        std::vector<DendogramNode> nodes;
+        for( std::size_t i = 0; i < dataset.size(); i++ )
+            nodes.push_back( dendogram.leaf(i) );
+
+        std::vector<double> heights;
+        while( nodes.size() > 1 ) {
+            std::size_t best_i = 0, best_j = 1;
+            double best = linkage( nodes[0], nodes[1] );
+            for( std::size_t i = 0; i < nodes.size(); i++ )
+                for( std::size_t j = i + 1; j < nodes.size(); j++ ) {
+                    double d = linkage( nodes[i], nodes[j] );
+                    if( d < best ) {
+                        best = d;
+                        best_i = i;
+                        best_j = j;
+                    }
+                }
+            heights.push_back( best );
+            nodes[best_i] = dendogram.merge( nodes[best_i], nodes[best_j], best );
+            nodes.erase( nodes.begin() + best_j );
+        }
+        std::sort( heights.begin(), heights.end() );
+        return heights;
+    }
+} // anonymous namespace
+
+namespace {
+    /* Same as FullLinkageUpdate, but forces generate_dendogram
+     * to use the generic algorithm.
+     */
+    double GenericFullLinkageUpdate(
+        const DendogramNode &, const DendogramNode &, double d1, double d2
+    ) {
+        return std::max( d1, d2 );
+    }
+} // anonymous namespace
+
+TEST_CASE( "Dendogram builder against naive clustering", "[dendogram]" ) {
+    std::mt19937 rng( 17 );
+    std::uniform_real_distribution<double> real( 0, 10 );
+    std::vector<DataEntry> entries;
+    for( int i = 0; i < 40; i++ )
+        entries.push_back( DataEntry({real(rng), real(rng)}, {}) );
+    DataSet dataset(
+        std::vector<std::string>{"x", "y"},
+        std::vector<std::string>{},
+        std::move( entries )
+    );
+
+    auto check = [&]( LinkageDistanceFunction linkage, LinkageDistanceUpdateFunction update ) {
+        auto dendogram = generate_dendogram( dataset, linkage, update );
+        CHECK( dendogram.root().size() == dataset.size() );
+        std::vector<double> heights;
+        merge_heights( dendogram.root(), heights );
+        std::sort( heights.begin(), heights.end() );
+        std::vector<double> expected = naive_merge_heights( dataset, linkage );
+        REQUIRE( heights.size() == expected.size() );
+        for( std::size_t i = 0; i < heights.size(); i++ )
+            CHECK( heights[i] == Approx( expected[i] ) );
+    };
+
+    SECTION( "Simple linkage" ) {
+        check( SimpleLinkage, SimpleLinkageUpdate );
+    }
+    SECTION( "Full linkage" ) {
+        check( FullLinkage, FullLinkageUpdate );
+    }
+    SECTION( "Mean linkage" ) {
+        check( MeanLinkage, MeanLinkageUpdate );
+    }
+    SECTION( "Generic algorithm" ) {
+        check( FullLinkage, GenericFullLinkageUpdate );
+    }
+    SECTION( "Ward linkage" ) {
+        check( WardLinkage, WardLinkageUpdate );
+    }
+    SECTION( "Centroid linkage" ) {
+        check( CentroidLinkage, CentroidLinkageUpdate );
+    }
+    SECTION( "Median linkage" ) {
+        check( MedianLinkage, MedianLinkageUpdate );
+    }
+    SECTION( "Weighted linkage" ) {
+        check( WeightedLinkage, WeightedLinkageUpdate );
+    }
+
+    SECTION( "Single precision in a memory-mapped file" ) {
+        temporary_path temporary;
+        DistanceStorage storage{ true, temporary.path };
+        for( auto update : {GenericFullLinkageUpdate, MeanLinkageUpdate} ) {
+            auto dendogram = generate_dendogram( dataset, FullLinkage, update, storage );
+            CHECK( dendogram.root().size() == dataset.size() );
+        }
+    }
+}
+
+TEST_CASE( "Lance-Williams linkages", "[dendogram]" ) {
+    DataSet dataset(
+        std::vector<std::string>{"x", "y"},
+        std::vector<std::string>{},
+        std::vector<DataEntry>{
+            DataEntry({0, 0}, {}, "A"),
+            DataEntry({2, 0}, {}, "B"),
+            DataEntry({0, 6}, {}, "C"),
+        }
+    );
+    Dendogram dendogram( dataset );
+    auto ab = dendogram.merge( dendogram.leaf(0), dendogram.leaf(1), 2 );
+    auto c = dendogram.leaf( 2 );
+    double ac = 6, bc = std::sqrt( 40.0 );
+
+    // Centroid of A and B is (1, 0).
+    CHECK( CentroidLinkage( c, ab ) == Approx( std::sqrt( 37.0 ) ) );
+    CHECK( CentroidLinkageUpdate( c, ab, ac, bc ) == Approx( std::sqrt( 37.0 ) ) );
+    CHECK( MedianLinkageUpdate( c, ab, ac, bc ) == Approx( std::sqrt( 37.0 ) ) );
+    CHECK( WardLinkage( c, ab ) == Approx( std::sqrt( 4.0 / 3 * 37 ) ) );
+    CHECK( WardLinkageUpdate( c, ab, ac, bc ) == Approx( std::sqrt( 4.0 / 3 * 37 ) ) );
+    CHECK( WeightedLinkage( c, ab ) == Approx( (ac + bc) / 2 ) );
+    CHECK( WeightedLinkageUpdate( c, ab, ac, bc ) == Approx( (ac + bc) / 2 ) );
+
+    const LinkageMethod * ward = find_linkage_method( "ward" );
+    REQUIRE( ward != nullptr );
+    CHECK( ward->distance == WardLinkage );
+    CHECK( ward->update == WardLinkageUpdate );
+    CHECK( find_linkage_method( "simple" )->update == SimpleLinkageUpdate );
+    CHECK( find_linkage_method( "nonexistent" ) == nullptr );
+}
+
+TEST_CASE( "Single linkage dendogram with ties", "[dendogram]" ) {
+    std::mt19937 rng( 23 );
+    std::uniform_int_distribution<int> integer( 0, 6 );
+    std::vector<DataEntry> entries;
+    for( int i = 0; i < 60; i++ )
+        entries.push_back( DataEntry({(double) integer(rng), (double) integer(rng)}, {}) );
+    DataSet dataset(
+        std::vector<std::string>{"x", "y"},
+        std::vector<std::string>{},
+        std::move( entries )
+    );
+
+    auto dendogram = generate_single_linkage_dendogram( dataset );
+    CHECK( dendogram.root().size() == dataset.size() );
+    std::vector<double> heights;
+    merge_heights( dendogram.root(), heights );
+    std::sort( heights.begin(), heights.end() );
+    CHECK( heights == naive_merge_heights( dataset, SimpleLinkage ) );
+
+    DataSet single( std::vector<std::string>{"x"}, {}, {DataEntry({1}, {}, "A")} );
+    auto leaf = generate_single_linkage_dendogram( single );
+    REQUIRE( leaf.root().leaf() );
+    CHECK( leaf.root().data().name() == "A" );
+}
+
+TEST_CASE( "Pairwise euclidean distances", "[dendogram]" ) {
+    std::mt19937 rng( 29 );
+    std::uniform_real_distribution<double> real( -5, 5 );
+    std::vector<DataEntry> entries;
+    for( int i = 0; i < 700; i++ )
+        entries.push_back( DataEntry({real(rng), real(rng), real(rng)}, {}) );
+    DataSet dataset(
+        std::vector<std::string>{"x", "y", "z"},
+        std::vector<std::string>{},
+        std::move( entries )
+    );
+
+    unsigned threads = util::thread_count();
+    util::thread_count() = 3;
+    DistanceMatrix euclidean = EuclideanDistances( dataset ).matrix();
+    util::thread_count() = threads;
+
+    EuclideanDistance reference( 0 );
+    for( std::size_t i = 0; i < dataset.size(); i += 7 )
+        for( std::size_t j = i + 1; j < dataset.size(); j += 13 ) {
+            const DataEntry & a = dataset.begin()[i];
+            const DataEntry & b = dataset.begin()[j];
+            // Bit-for-bit equal to the distance calculator.
+            CHECK( euclidean(i, j) == reference(a, b) );
+        }
+}
+
+TEST_CASE( "Dendogram classification", "[dendogram]" ) {
+    std::mt19937 rng( 31 );
+    std::uniform_int_distribution<int> integer( 0, 3 );
+    std::vector<DataEntry> entries;
+    // Three groups in the corners of a triangle, with many repeated points.
+    double corners[3][2] = {{0, 0}, {100, 0}, {50, 87}};
+    for( int i = 0; i < 90; i++ )
+        entries.push_back( DataEntry(
+            {corners[i%3][0] + integer(rng), corners[i%3][1] + integer(rng)},
+            {},
+            std::to_string(i)
+        ) );
+    DataSet dataset(
+        std::vector<std::string>{"x", "y"},
+        std::vector<std::string>{},
+        std::move( entries )
+    );
+    auto dendogram = generate_dendogram( dataset, FullLinkage, FullLinkageUpdate );
+    DendogramNode root = dendogram.root();
+
+    SECTION( "Split profile" ) {
+        std::vector<double> heights;
+        merge_heights( root, heights );
+        std::sort( heights.rbegin(), heights.rend() );
+        // Full linkage is monotone, so the splits follow the merges backwards.
+        CHECK( split_linkage_profile( root, 89 ) == heights );
+        CHECK( split_linkage_profile( root, 5 ) ==
+            std::vector<double>( heights.begin(), heights.begin() + 5 ) );
+        CHECK( split_linkage_profile( root, 0 ).empty() );
+        CHECK_THROWS( split_linkage_profile( root, 90 ) );
+    }
+
+    SECTION( "Optimum cut" ) {
+        auto data = classify_dendogram( root, 2, 10, dataset );
+        CHECK( data.classes == 3 );
+        CHECK( data.linkage_min_class >= data.linkage_upper_limit );
+        CHECK( data.linkage_upper_limit - data.linkage_lower_limit > 90 );
+        CHECK( data.linkage_lower_limit >= data.linkage_max_class );
+        REQUIRE( data.classified_dataset.size() == 90 );
+        std::map< std::string, std::set<int> > groups;
+        for( const DataEntry & entry : data.classified_dataset )
+            groups[entry.category(0)].insert( std::stoi( entry.name() ) % 3 );
+        REQUIRE( groups.size() == 3 );
+        for( const auto & pair : groups )
+            CHECK( pair.second.size() == 1 );
+    }
+
+    SECTION( "Every leaf in its own class" ) {
+        // Repeated points give structural nodes with zero linkage distance.
+        auto data = classify_dendogram( root, 90, 90, dataset );
+        CHECK( data.classes == 90 );
+        CHECK( data.classified_dataset.size() == 90 );
+    }
+
+    SECTION( "Cuts" ) {
+        auto cuts = cut_dendogram_classes( dendogram, {3, 1, 90} );
+        REQUIRE( cuts.size() == 3 );
+        CHECK( cuts[1] == std::vector<int>( 90, 0 ) );
+        std::vector<int> all( cuts[2] );
+        std::sort( all.begin(), all.end() );
+        for( int i = 0; i < 90; i++ )
+            CHECK( all[i] == i );
+
+        // Same classes of classify_dendogram, with the same numbering.
+        auto data = classify_dendogram( root, 3, 3, dataset );
+        std::map< std::string, std::string > category;
+        for( const DataEntry & entry : data.classified_dataset )
+            category[entry.name()] = entry.category(0);
+        for( int i = 0; i < 90; i++ ) {
+            CHECK( cuts[0][i] == i % 3 );
+            CHECK( category[std::to_string(i)] == "C" + std::to_string( cuts[0][i] + 1 ) );
+        }
+
+        auto thresholds = cut_dendogram_thresholds(
+            dendogram, {50, root.linkage_distance(), -1}
+        );
+        REQUIRE( thresholds.size() == 3 );
+        CHECK( thresholds[0] == cuts[0] );
+        CHECK( thresholds[1] == cuts[1] );
+        CHECK( thresholds[2] == cuts[2] );
+
+        CHECK_THROWS( cut_dendogram_classes( dendogram, {0} ) );
+        CHECK_THROWS( cut_dendogram_classes( dendogram, {91} ) );
+    }
+
+    CHECK_THROWS( classify_dendogram( root, 0, 10, dataset ) );
+    CHECK_THROWS( classify_dendogram( root, 5, 4, dataset ) );
+    CHECK_THROWS( classify_dendogram( root, 2, 91, dataset ) );
+}
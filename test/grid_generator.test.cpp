@@ -0,0 +1,53 @@
+#include "pr/grid_generator.h"
+#include <catch.hpp>
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+
+TEST_CASE( "Grid generation", "[grid]" ) {
+    DataSet dataset( 3, 0 );
+    dataset.push_back( DataEntry( {0.0, 0.0, 0.0}, {} ) );
+    dataset.push_back( DataEntry( {4.0, 2.0, 1.0}, {} ) );
+
+    GridGenerator grid;
+    grid.expand( 0 );
+    grid.density( {4, 2, 3} );
+    grid.calibrate( dataset );
+    REQUIRE( grid.size() == 5 * 3 * 4 );
+
+    SECTION( "Iteration" ) {
+        std::vector< DataEntry > points;
+        for( auto it = grid.begin(); it != grid.end(); it++ )
+            points.push_back( *it );
+        REQUIRE( points.size() == grid.size() );
+
+        // The last dimension varies fastest.
+        std::size_t k = 0;
+        for( unsigned i = 0; i <= 4; i++ )
+            for( unsigned j = 0; j <= 2; j++ )
+                for( unsigned l = 0; l <= 3; l++, k++ ) {
+                    CHECK( points[k].attribute(0) == Approx( i ) );
+                    CHECK( points[k].attribute(1) == Approx( j ) );
+                    CHECK( points[k].attribute(2) == Approx( l / 3.0 ) );
+                    CHECK( points[k].attributes() == grid( {i, j, l} ).attributes() );
+                }
+    }
+
+    SECTION( "Filling buffers" ) {
+        std::vector< double > all( 3 * grid.size() );
+        grid.fill( 0, grid.size(), all.data() );
+
+        std::size_t k = 0;
+        for( auto it = grid.begin(); it != grid.end(); ++it, k++ )
+            for( std::size_t a = 0; a < 3; a++ )
+                CHECK( all[3 * k + a] == (*it).attribute(a) );
+
+        // A block that crosses rows.
+        std::vector< double > block( 3 * 7 );
+        grid.fill( 10, 7, block.data() );
+        for( std::size_t i = 0; i < block.size(); i++ )
+            CHECK( block[i] == all[3 * 10 + i] );
+
+        CHECK_THROWS( grid.fill( grid.size() - 1, 2, block.data() ) );
+        CHECK_NOTHROW( grid.fill( grid.size(), 0, block.data() ) );
+    }
+}
@@ -0,0 +1,312 @@
+#include "pr/ibl.h"
+#include <catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+#include "pr/p_norm.h"
+#include "util/interval.h"
+#include "util/parallel.hpp"
+
+namespace {
+    /* Result of a training: the counts and the conceptual descriptor.
+     */
+    struct training {
+        int hits;
+        int misses;
+        std::vector<DataEntry> descriptor;
+    };
+
+    training result_of( const ibl & trained ) {
+        const DataSet & descriptor = trained.conceptual_descriptor();
+        return training{
+            trained.hit_count(),
+            trained.miss_count(),
+            std::vector<DataEntry>( descriptor.begin(), descriptor.end() )
+        };
+    }
+
+    /* Metric of IBL 3, for linear_ibl3.
+     */
+    struct euclidean_metric {
+        double distance( const DataEntry & x, const DataEntry & y ) const {
+            return EuclideanDistance(0)( x, y );
+        }
+        void update( const DataEntry &, const DataEntry &, double ) {}
+    };
+
+    /* Metric of IBL 4, for linear_ibl3; same formulas as ibl4.
+     */
+    struct weighted_metric {
+        std::vector<double> weights, accumulated, normalized;
+
+        explicit weighted_metric( std::size_t attributes ) :
+            weights( attributes, 1.0 ),
+            accumulated( attributes, 1.0 ),
+            normalized( attributes, 1.0 )
+        {}
+
+        double distance( const DataEntry & x, const DataEntry & y ) const {
+            double res = 0;
+            for( std::size_t i = 0; i < weights.size(); i++ ) {
+                double d = weights[i] * (x.attribute(i) - y.attribute(i));
+                res += d * d;
+            }
+            return std::sqrt( res );
+        }
+
+        void update( const DataEntry & a, const DataEntry & b, double lambda ) {
+            for( std::size_t i = 0; i < weights.size(); i++ ) {
+                double d = std::fabs( a.attribute(i) - b.attribute(i) );
+                if( a.categories() == b.categories() )
+                    accumulated[i] += (1 - lambda) * (1 - d);
+                else
+                    accumulated[i] += (1 - lambda) * d;
+                normalized[i] += (1 - lambda);
+                weights[i] = std::max( accumulated[i] / normalized[i] - .5, 0. );
+            }
+        }
+    };
+
+    /* Straightforward IBL 3: every search is a linear scan
+     * over the instances, which are never compacted.
+     * Ties are broken towards the oldest instance, as in KDTree.
+     */
+    template< typename Metric >
+    training linear_ibl3( const DataSet & dataset, long long unsigned seed, Metric metric ) {
+        const double accept = 0.9, reject = 0.75;
+        std::mt19937 rng( seed );
+
+        struct instance {
+            DataEntry entry;
+            std::size_t category;
+            int use_count;
+            int correct_use_count;
+            bool alive;
+        };
+        std::vector< instance > instances;
+        std::size_t live = 0;
+
+        std::map< std::string, std::size_t > category_id;
+        std::vector< std::size_t > appearances;
+        int trained = 0;
+
+        auto count = [&]( const DataEntry & entry ) {
+            auto insertion = category_id.emplace( entry.category(0), category_id.size() );
+            if( insertion.second )
+                appearances.push_back( 0 );
+            appearances[insertion.first->second]++;
+            trained++;
+            return insertion.first->second;
+        };
+        auto frequency = [&]( std::size_t category, double z ) {
+            return frequency_interval( (double) appearances[category] / trained, trained, z );
+        };
+        auto precision = [&]( const instance & i, double z ) {
+            return precision_interval( (double) i.correct_use_count / i.use_count, i.use_count, z );
+        };
+        auto acceptable = [&]( const instance & i ) {
+            if( i.use_count == 0 ) return true;
+            return frequency( i.category, accept ).max <= precision( i, accept ).min;
+        };
+        auto rejectable = [&]( const instance & i ) {
+            if( i.use_count == 0 ) return false;
+            return precision( i, reject ).max <= frequency( i.category, reject ).min;
+        };
+        auto add = [&]( const DataEntry & entry, std::size_t category ) {
+            instances.push_back( {entry, category, 0, 0, true} );
+            live++;
+        };
+
+        training result{ 0, 0, {} };
+        auto it = dataset.begin();
+        add( *it, count(*it) );
+        result.misses++;
+
+        while( ++it != dataset.end() ) {
+            std::size_t closest = instances.size();
+            double best = 0;
+            for( std::size_t id = 0; id < instances.size(); id++ ) {
+                const instance & i = instances[id];
+                if( !i.alive || !acceptable(i) )
+                    continue;
+                double d = metric.distance( i.entry, *it );
+                if( closest == instances.size() || d < best ) {
+                    closest = id;
+                    best = d;
+                }
+            }
+
+            if( live == 0 ) {
+                add( *it, count(*it) );
+                result.misses++;
+                continue;
+            }
+
+            if( closest == instances.size() ) {
+                std::size_t random = rng() % live;
+                closest = 0;
+                while( !instances[closest].alive || random-- > 0 )
+                    closest++;
+            }
+
+            std::size_t category = count( *it );
+            instances[closest].use_count++;
+            bool correct = instances[closest].entry.categories() == it->categories();
+            if( correct )
+                instances[closest].correct_use_count++;
+
+            DataEntry closest_entry = instances[closest].entry;
+            std::size_t closest_category = instances[closest].category;
+            double threshold = metric.distance( closest_entry, *it );
+
+            if( correct )
+                result.hits++;
+            else {
+                result.misses++;
+                add( *it, category );
+            }
+
+            for( instance & i : instances )
+                if( i.alive && metric.distance( i.entry, *it ) <= threshold && rejectable(i) ) {
+                    i.alive = false;
+                    live--;
+                }
+
+            double lambda =
+                std::max( appearances[category], appearances[closest_category] )
+                / (double) trained;
+            metric.update( *it, closest_entry, lambda );
+        }
+
+        for( const instance & i : instances )
+            if( i.alive && i.use_count > 0 )
+                result.descriptor.push_back( i.entry );
+        return result;
+    }
+
+    /* Two noisy classes in the unit square.
+     * With integer coordinates, many distances tie.
+     */
+    DataSet noisy_dataset( unsigned seed, std::size_t size, bool integer ) {
+        std::mt19937 rng( seed );
+        std::uniform_real_distribution<double> real( 0, 1 );
+        std::vector<DataEntry> entries;
+        for( std::size_t i = 0; i < size; i++ ) {
+            double x = real(rng), y = real(rng);
+            bool flip = real(rng) < 0.1;
+            if( integer ) {
+                x = std::floor( 8 * x ) / 8;
+                y = std::floor( 8 * y ) / 8;
+            }
+            entries.push_back( DataEntry({x, y}, {(x > y) != flip ? "A" : "B"}) );
+        }
+        return DataSet(
+            std::vector<std::string>{"X", "Y"},
+            std::vector<std::string>{"Type"},
+            std::move( entries )
+        );
+    }
+
+    void check_same( const training & actual, const training & expected ) {
+        CHECK( actual.hits == expected.hits );
+        CHECK( actual.misses == expected.misses );
+        REQUIRE( actual.descriptor.size() == expected.descriptor.size() );
+        for( std::size_t i = 0; i < actual.descriptor.size(); i++ ) {
+            CHECK( actual.descriptor[i].attributes() == expected.descriptor[i].attributes() );
+            CHECK( actual.descriptor[i].categories() == expected.descriptor[i].categories() );
+        }
+    }
+} // anonymous namespace
+
+TEST_CASE( "Indexed IBL 3 and IBL 4 match a linear scan", "[ibl]" ) {
+    for( bool integer : {false, true} ) {
+        DataSet dataset = noisy_dataset( 11, 500, integer );
+
+        ibl3 three;
+        three.seed( 5 );
+        three.train( dataset );
+        check_same( result_of(three), linear_ibl3( dataset, 5, euclidean_metric() ) );
+
+        ibl4 four;
+        four.seed( 7 );
+        four.train( dataset );
+        check_same(
+            result_of(four),
+            linear_ibl3( dataset, 7, weighted_metric(dataset.attribute_count()) )
+        );
+    }
+}
+
+TEST_CASE( "Indexed IBL 3 and IBL 4 keep the counts consistent", "[ibl]" ) {
+    DataSet dataset = noisy_dataset( 11, 500, false );
+
+    ibl3 three;
+    three.seed( 5 );
+    three.train( dataset );
+    CHECK( three.hit_count() + three.miss_count() == (int) dataset.size() );
+    CHECK( three.conceptual_descriptor().size() > 0 );
+    // The noise makes IBL 3 actually discard instances.
+    CHECK( three.conceptual_descriptor().size() < (std::size_t) three.miss_count() );
+
+    ibl4 four;
+    four.train( dataset );
+    CHECK( four.hit_count() + four.miss_count() == (int) dataset.size() );
+    CHECK( four.conceptual_descriptor().size() > 0 );
+
+    // The training is deterministic, given the seed.
+    ibl3 again;
+    again.seed( 5 );
+    again.train( dataset );
+    check_same( result_of(again), result_of(three) );
+}
+
+TEST_CASE( "Sharded IBL 4 is deterministic", "[ibl]" ) {
+    std::mt19937 rng( 3 );
+    std::uniform_real_distribution<double> real( 0, 1 );
+    std::vector<DataEntry> entries;
+    for( int i = 0; i < 600; i++ ) {
+        double x = real(rng), y = real(rng);
+        entries.push_back( DataEntry({x, y}, {x > y ? "A" : "B"}) );
+    }
+    DataSet dataset(
+        std::vector<std::string>{"X", "Y"},
+        std::vector<std::string>{"Type"},
+        std::move( entries )
+    );
+
+    ibl4 sequential;
+    sequential.seed( 9 );
+    sequential.train( dataset );
+    check_same(
+        result_of(sequential),
+        linear_ibl3( dataset, 9, weighted_metric(dataset.attribute_count()) )
+    );
+
+    // A single shard is exactly the sequential training.
+    ibl4 single;
+    single.seed( 9 );
+    single.shards( 1 );
+    single.train( dataset );
+    check_same( result_of(single), result_of(sequential) );
+
+    unsigned threads = util::thread_count();
+    std::vector<training> results;
+    for( unsigned t : {1u, 4u} ) {
+        util::thread_count() = t;
+        ibl4 sharded;
+        sharded.seed( 9 );
+        sharded.shards( 4 );
+        sharded.train( dataset );
+        CHECK( sharded.hit_count() + sharded.miss_count() == (int) dataset.size() );
+        results.push_back( result_of(sharded) );
+    }
+    util::thread_count() = threads;
+    check_same( results[1], results[0] );
+
+    ibl4 invalid;
+    CHECK_THROWS( invalid.shards( 0 ) );
+}
@@ -0,0 +1,203 @@
+#include "pr/kd_tree.h"
+#include <catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+#include "pr/ibl.h"
+#include "pr/nearest_neighbor.h"
+#include "pr/p_norm.h"
+#include "util/parallel.hpp"
+
+namespace {
+    /* Linear scan equivalent to KDTree::nearest.
+     */
+    std::size_t brute_force_nearest(
+        const std::vector<DataEntry> & points,
+        const DataEntry & target,
+        std::size_t limit
+    ) {
+        EuclideanDistance distance(0);
+        std::size_t best = KDTree::npos;
+        double best_distance = 0;
+        for( std::size_t i = 0; i < limit && i < points.size(); i++ ) {
+            double d = distance( points[i], target );
+            if( best == KDTree::npos || d < best_distance ) {
+                best = i;
+                best_distance = d;
+            }
+        }
+        return best;
+    }
+} // anonymous namespace
+
+TEST_CASE( "KDTree against linear scan", "[kd_tree]" ) {
+    std::mt19937 rng( 42 );
+    std::uniform_real_distribution<double> real( -10, 10 );
+    /* Integer coordinates generate lots of ties,
+     * which must be broken in favor of the smallest id.
+     */
+    std::uniform_int_distribution<int> integer( 0, 3 );
+
+    SECTION( "Real coordinates" ) {
+        KDTree tree( 3 );
+        std::vector<DataEntry> points;
+        for( int i = 0; i < 300; i++ ) {
+            points.push_back( DataEntry({real(rng), real(rng), real(rng)}, {}) );
+            CHECK( tree.insert( points.back() ) == (std::size_t) i );
+        }
+        REQUIRE( tree.size() == 300 );
+
+        for( int i = 0; i < 100; i++ ) {
+            DataEntry target({real(rng), real(rng), real(rng)}, {});
+            CHECK( tree.nearest(target) == brute_force_nearest(points, target, 300) );
+            CHECK( tree.nearest(target, i) == brute_force_nearest(points, target, i) );
+        }
+    }
+
+    SECTION( "Repeated coordinates" ) {
+        KDTree tree( 2 );
+        std::vector<DataEntry> points;
+        for( int i = 0; i < 200; i++ ) {
+            points.push_back( DataEntry({(double) integer(rng), (double) integer(rng)}, {}) );
+            tree.insert( points.back() );
+        }
+        for( int i = 0; i < 100; i++ ) {
+            DataEntry target({(double) integer(rng), (double) integer(rng)}, {});
+            CHECK( tree.nearest(target) == brute_force_nearest(points, target, 200) );
+            CHECK( tree.nearest(target, 2*i) == brute_force_nearest(points, target, 2*i) );
+        }
+    }
+
+    SECTION( "Empty tree" ) {
+        KDTree tree( 2 );
+        CHECK( tree.nearest(DataEntry({0, 0}, {})) == KDTree::npos );
+        tree.insert( DataEntry({1, 1}, {}) );
+        CHECK( tree.nearest(DataEntry({0, 0}, {}), 0) == KDTree::npos );
+        CHECK( tree.nearest(DataEntry({0, 0}, {})) == 0 );
+    }
+}
+
+TEST_CASE( "Indexed IBL 1 and IBL 2 match plain nearest neighbor", "[kd_tree][ibl]" ) {
+    std::mt19937 rng( 7 );
+    std::uniform_real_distribution<double> real( 0, 1 );
+    std::vector<DataEntry> entries;
+    for( int i = 0; i < 400; i++ ) {
+        double x = real(rng), y = real(rng);
+        entries.push_back( DataEntry({x, y}, {x + y > 1 ? "A" : "B"}) );
+    }
+    DataSet dataset(
+        std::vector<std::string>{"X", "Y"},
+        std::vector<std::string>{"Type"},
+        std::move( entries )
+    );
+
+    /* Reference implementation: the textbook IBL 2,
+     * classifying every entry against the whole conceptual descriptor.
+     */
+    NearestNeighbor reference(
+        std::make_unique<DataSet>( dataset.header() ),
+        std::make_unique<EuclideanDistance>(0),
+        1,
+        false
+    );
+    int hits = 0, misses = 1;
+    reference.edit_dataset().push_back( DataEntry(*dataset.begin()) );
+    for( auto it = dataset.begin() + 1; it != dataset.end(); ++it )
+        if( reference.classify(*it) == it->categories() )
+            hits++;
+        else {
+            misses++;
+            reference.edit_dataset().push_back( DataEntry(*it) );
+        }
+
+    ibl2 trained;
+    trained.train( dataset );
+    CHECK( trained.hit_count() == hits );
+    CHECK( trained.miss_count() == misses );
+    CHECK( trained.conceptual_descriptor().size() == reference.dataset().size() );
+
+    // Same for IBL 1, whose training runs in parallel.
+    hits = 0, misses = 1;
+    reference.edit_dataset() = dataset.header();
+    reference.edit_dataset().push_back( DataEntry(*dataset.begin()) );
+    for( auto it = dataset.begin() + 1; it != dataset.end(); ++it ) {
+        if( reference.classify(*it) == it->categories() )
+            hits++;
+        else
+            misses++;
+        reference.edit_dataset().push_back( DataEntry(*it) );
+    }
+
+    unsigned threads = util::thread_count();
+    util::thread_count() = 4;
+    ibl1 everything;
+    everything.train( dataset );
+    util::thread_count() = threads;
+
+    CHECK( everything.hit_count() == hits );
+    CHECK( everything.miss_count() == misses );
+    CHECK( everything.conceptual_descriptor().size() == dataset.size() );
+}
+
+TEST_CASE( "KDTree generic queries against linear scan", "[kd_tree]" ) {
+    std::mt19937 rng( 13 );
+    std::uniform_int_distribution<int> integer( 0, 5 );
+    std::vector<double> weights{ 0.5, 2.0, 0.0 };
+
+    KDTree tree( 3 );
+    std::vector<DataEntry> points;
+    for( int i = 0; i < 250; i++ ) {
+        points.push_back( DataEntry({
+            (double) integer(rng), (double) integer(rng), (double) integer(rng)
+        }, {}) );
+        tree.insert( points.back() );
+    }
+
+    // Weighted euclidean distance, as used by IBL 4.
+    auto weighted = [&]( const DataEntry & x, const DataEntry & y ) {
+        double sum = 0;
+        for( std::size_t i = 0; i < weights.size(); i++ ) {
+            double d = weights[i] * (x.attribute(i) - y.attribute(i));
+            sum += d * d;
+        }
+        return std::sqrt( sum );
+    };
+
+    for( int i = 0; i < 60; i++ ) {
+        DataEntry target({
+            (double) integer(rng), (double) integer(rng), (double) integer(rng)
+        }, {});
+        KDTree::Distance distance = [&]( std::size_t id ) {
+            return weighted( points[id], target );
+        };
+        KDTree::Filter odd = []( std::size_t id ) { return id % 2 == 1; };
+
+        std::size_t expected = KDTree::npos;
+        double best = 0;
+        for( std::size_t id = 1; id < points.size(); id += 2 )
+            if( expected == KDTree::npos || distance(id) < best ) {
+                expected = id;
+                best = distance(id);
+            }
+        CHECK( tree.nearest(target, distance, odd, &weights) == expected );
+
+        double radius = integer(rng);
+        std::vector<std::size_t> found;
+        tree.within( target, radius, distance, odd,
+            [&]( std::size_t id ) { found.push_back(id); },
+            &weights
+        );
+        std::sort( found.begin(), found.end() );
+        std::vector<std::size_t> inside;
+        for( std::size_t id = 1; id < points.size(); id += 2 )
+            if( distance(id) <= radius )
+                inside.push_back( id );
+        CHECK( found == inside );
+    }
+
+    KDTree::Filter nothing = []( std::size_t ) { return false; };
+    CHECK( tree.nearest(points[0], [](std::size_t){ return 0.0; }, nothing) == KDTree::npos );
+}
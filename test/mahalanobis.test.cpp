@@ -0,0 +1,106 @@
+#include "pr/mahalanobis.h"
+#include <catch.hpp>
+#include <cmath>
+#include <random>
+
+#include "pr/data_entry.h"
+#include "pr/data_set.h"
+
+namespace {
+    /* Euclidean norm of W (x - m).
+     */
+    double whitened_norm( const cv::Mat_<double> & w, const DataEntry & m, const DataEntry & x ) {
+        double sum = 0;
+        for( int i = 0; i < w.rows; i++ ) {
+            double row = 0;
+            for( int j = 0; j < w.cols; j++ )
+                row += w(i, j) * (x.attribute(j) - m.attribute(j));
+            sum += row * row;
+        }
+        return std::sqrt( sum );
+    }
+
+    void check_whitening( const DataSet & dataset, unsigned seed ) {
+        MahalanobisDistance distance;
+        distance.calibrate( dataset );
+        cv::Mat_<double> w = distance.whitening();
+        REQUIRE( w.rows == (int) dataset.attribute_count() );
+        REQUIRE( w.cols == (int) dataset.attribute_count() );
+        for( int i = 0; i < w.rows; i++ )
+            for( int j = 0; j < i; j++ )
+                CHECK( w(i, j) == 0 );
+
+        std::mt19937 rng( seed );
+        std::uniform_real_distribution<double> coordinate( -5, 5 );
+        for( int k = 0; k < 20; k++ ) {
+            std::vector<double> a, b;
+            for( std::size_t i = 0; i < dataset.attribute_count(); i++ ) {
+                a.push_back( coordinate(rng) );
+                b.push_back( coordinate(rng) );
+            }
+            DataEntry m( std::move(a), {} ), x( std::move(b), {} );
+            CHECK( whitened_norm( w, m, x ) == Approx( distance( m, x ) ) );
+        }
+    }
+} // anonymous namespace
+
+TEST_CASE( "Mahalanobis distance calibration", "[distance][mahalanobis]" ) {
+    /* The mean is (3, 4), and calibrate sums the outer products
+     * of the deviations from the mean, (-2, -2), (0, -1), (-1, 3) and (3, 0):
+     *
+     *      [14  1]                        1   [14 -1]
+     *      [ 1 14],  whose inverse is    --- [-1 14].
+     *                                    195
+     */
+    DataSet dataset( 2, 0 );
+    dataset.push_back( DataEntry( {1, 2}, {} ) );
+    dataset.push_back( DataEntry( {3, 3}, {} ) );
+    dataset.push_back( DataEntry( {2, 7}, {} ) );
+    dataset.push_back( DataEntry( {6, 4}, {} ) );
+    MahalanobisDistance distance;
+    distance.calibrate( dataset );
+
+    // The squared distance of each difference v is v^T S^-1 v.
+    DataEntry m( {10, -3}, {} );
+    auto squared = [&]( double dx, double dy ) {
+        double d = distance( m, DataEntry( {10 + dx, -3 + dy}, {} ) );
+        return d * d;
+    };
+    CHECK( squared( 1, 0 ) == Approx( 14 / 195.0 ) );
+    CHECK( squared( 0, 1 ) == Approx( 14 / 195.0 ) );
+    CHECK( squared( 1, 1 ) == Approx( 26 / 195.0 ) );
+    CHECK( squared( 1, -1 ) == Approx( 30 / 195.0 ) );
+    CHECK( squared( 0, 0 ) == 0 );
+
+    // Translating the dataset moves the mean, but not the covariance.
+    DataSet moved( 2, 0 );
+    for( const DataEntry & entry : dataset )
+        moved.push_back( DataEntry( {entry.attribute(0) + 7, entry.attribute(1) - 2}, {} ) );
+    MahalanobisDistance same;
+    same.calibrate( moved );
+    DataEntry x( {1, 5}, {} );
+    CHECK( same( m, x ) == Approx( distance( m, x ) ) );
+}
+
+TEST_CASE( "Mahalanobis whitening transform", "[distance][mahalanobis]" ) {
+    SECTION( "Regular covariance" ) {
+        std::mt19937 rng( 4 );
+        std::normal_distribution<double> normal( 0, 1 );
+        DataSet dataset( 3, 0 );
+        for( int i = 0; i < 50; i++ ) {
+            double a = normal(rng), b = normal(rng), c = normal(rng);
+            dataset.push_back( DataEntry( {a, a + b, 2*c - b}, {} ) );
+        }
+        check_whitening( dataset, 6 );
+    }
+
+    SECTION( "Singular covariance" ) {
+        // The second attribute is twice the first.
+        DataSet dataset( 3, 0 );
+        dataset.push_back( DataEntry( {0, 0, 1}, {} ) );
+        dataset.push_back( DataEntry( {1, 2, 0}, {} ) );
+        dataset.push_back( DataEntry( {2, 4, 1}, {} ) );
+        dataset.push_back( DataEntry( {3, 6, 0}, {} ) );
+        check_whitening( dataset, 7 );
+    }
+}
@@ -3,7 +3,11 @@
 
 #include "pr/data_set.h"
 #include "pr/data_entry.h"
+#include "pr/decision_map.h"
 #include "pr/p_norm.h"
+#include "util/parallel.hpp"
+#include <algorithm>
+#include <random>
 
 DataSet xy_data(
     std::vector<std::string>{"X pos", "Y pos"},
@@ -24,6 +28,23 @@ std::vector<std::string> category_A = {"A"};
 std::vector<std::string> category_B = {"B"};
 std::vector<std::string> category_C = {"C"};
 
+namespace {
+    /* Sixty random points in (-10, 10)², in three regions
+     * split by the lines x + y = 4 and x = y.
+     */
+    DataSet scattered_dataset( unsigned seed ) {
+        std::mt19937 rng( seed );
+        std::uniform_real_distribution<double> coordinate( -10, 10 );
+        DataSet data( 2, 1 );
+        for( int i = 0; i < 60; i++ ) {
+            double x = coordinate( rng ), y = coordinate( rng );
+            std::string category = x + y > 4 ? "A" : x < y ? "B" : "C";
+            data.push_back( DataEntry({x, y}, {category}) );
+        }
+        return data;
+    }
+} // anonymous namespace
+
 TEST_CASE( "Euclidean Nearest Neighbor, NN=1, one category", "[nn][trivial]" ) {
     std::unique_ptr<DistanceCalculator> distance(new EuclideanDistance(0));
     std::unique_ptr<DataSet> dataset(new DataSet(xy_data));
@@ -93,3 +114,110 @@ TEST_CASE( "Manhattan Nearest Neighbor, NN=2, one category", "[nn][two_neighbors
     CHECK( nn.classify(DataEntry({10,-10},{})) == category_B );
     CHECK( nn.classify(DataEntry({-10,10},{})) == category_C );
 }
+
+TEST_CASE( "Concurrent Nearest Neighbor after recalibration", "[nn]" ) {
+    std::unique_ptr<DistanceCalculator> distance(new EuclideanDistance(0));
+    std::unique_ptr<DataSet> dataset(new DataSet(xy_data));
+    NearestNeighbor nn(std::move(dataset), std::move(distance), 1);
+
+    // The new entries change the normalization.
+    nn.edit_dataset().push_back( DataEntry({-1000, 0}, {"C"}) );
+    nn.edit_dataset().push_back( DataEntry({1000, 0}, {"C"}) );
+    nn.recalibrate();
+
+    std::vector<DataEntry> queries;
+    for( int i = 0; i < 400; i++ )
+        queries.push_back( DataEntry({i % 20 - 10.0, i / 20 - 10.0}, {}) );
+    std::vector< std::vector<std::string> > results( queries.size() );
+    util::parallel_for( 0, queries.size(), [&]( std::size_t i ) {
+        results[i] = nn.classify( queries[i] );
+    });
+    for( std::size_t i = 0; i < queries.size(); i++ )
+        CHECK( results[i] == nn.classify( queries[i] ) );
+    CHECK( nn.classify(DataEntry({900,0},{})) == category_C );
+}
+
+TEST_CASE( "Rasterized Nearest Neighbor", "[nn][raster]" ) {
+    DataSet data = scattered_dataset( 5 );
+
+    for( unsigned k : {1, 2, 3} )
+        for( bool euclidean : {true, false} ) {
+            auto make = [&]() {
+                std::unique_ptr<DistanceCalculator> distance;
+                if( euclidean )
+                    distance.reset( new EuclideanDistance(0.1) );
+                else
+                    distance.reset( new ManhattanDistance(0.1) );
+                return std::make_unique<NearestNeighbor>(
+                    std::make_unique<DataSet>(data), std::move(distance), k
+                );
+            };
+            auto exact_ptr = make();
+            auto raster_ptr = make();
+            NearestNeighbor & exact = *exact_ptr;
+            NearestNeighbor & raster = *raster_ptr;
+            raster.rasterize( 24 );
+            CHECK( raster.raster_coverage() > 0.5 );
+
+            for( double x = -12; x < 12; x += 0.173 )
+                for( double y = -12; y < 12; y += 0.191 ) {
+                    DataEntry query( {x, y}, {} );
+                    CHECK( raster.classify(query) == exact.classify(query) );
+                }
+
+            raster.edit_dataset();
+            CHECK( raster.raster_coverage() == 0 );
+        }
+}
+
+TEST_CASE( "Quadtree classification of the plane", "[nn][decision_map]" ) {
+    DataSet scattered = scattered_dataset( 8 );
+
+    /* A lattice, with a repeated point of another category.
+     * The coordinates of the plane are multiples of 1/8,
+     * so, without normalization, many distances tie exactly.
+     */
+    DataSet lattice( 2, 1 );
+    for( int i = 0; i < 5; i++ )
+        for( int j = 0; j < 5; j++ )
+            lattice.push_back( DataEntry({(double) i, (double) j}, {std::to_string((2*i + j) % 3)}) );
+    lattice.push_back( DataEntry({2, 2}, {"1"}) );
+
+    struct plane {
+        const DataSet & data;
+        bool normalize;
+        double low, high, step;
+    };
+    for( const plane & p : {plane{scattered, true, -12, 12, 0.25}, plane{lattice, false, -0.5, 4.5, 0.125}} ) {
+        std::vector<double> xs, ys;
+        for( double x = p.low; x <= p.high; x += p.step )
+            xs.push_back( x );
+        for( double y = p.low; y <= p.high - 4 * p.step; y += p.step )
+            ys.push_back( y );
+
+        std::vector<std::string> categories;
+        for( const DataEntry & entry : p.data )
+            if( std::find( categories.begin(), categories.end(), entry.category(0) ) == categories.end() )
+                categories.push_back( entry.category(0) );
+
+        for( unsigned k : {1, 2, 3, 4} )
+            for( bool euclidean : {true, false} ) {
+                std::unique_ptr<DistanceCalculator> distance;
+                if( euclidean )
+                    distance.reset( new EuclideanDistance(0.1) );
+                else
+                    distance.reset( new ManhattanDistance(0.1) );
+                NearestNeighbor nn(
+                    std::make_unique<DataSet>(p.data), std::move(distance), k, p.normalize
+                );
+
+                auto labels = classify_plane( nn, xs, ys );
+                REQUIRE( labels.size() == xs.size() * ys.size() );
+                for( std::size_t y = 0; y < ys.size(); y++ )
+                    for( std::size_t x = 0; x < xs.size(); x++ ) {
+                        DataEntry query( {xs[x], ys[y]}, {} );
+                        CHECK( categories[labels[y * xs.size() + x]] == nn.classify(query)[0] );
+                    }
+            }
+    }
+}
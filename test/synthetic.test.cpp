@@ -0,0 +1,76 @@
+#include "pr/synthetic.h"
+#include <catch.hpp>
+
+#include "pr/binary_dataset.h"
+#include "pr/data_set.h"
+#include "pr/data_entry.h"
+
+TEST_CASE( "Synthetic datasets", "[synthetic]" ) {
+    for( auto shape : {SyntheticDataset::gaussian, SyntheticDataset::uniform, SyntheticDataset::spiral} ) {
+        SyntheticDataset generator( shape, 3, 4, 0.1, 42 );
+        SyntheticDataset same( shape, 3, 4, 0.1, 42 );
+        SyntheticDataset other( shape, 3, 4, 0.1, 43 );
+
+        SECTION( "Determinism" ) {
+            double a[3], b[3], c[3];
+            bool differs = false;
+            // Generated backwards, to check that the order does not matter.
+            for( std::uint64_t i = 100; i-- > 0; ) {
+                CHECK( generator.generate( i, a ) == same.generate( i, b ) );
+                for( int k = 0; k < 3; k++ )
+                    CHECK( a[k] == b[k] );
+                other.generate( i, c );
+                differs = differs || a[0] != c[0];
+            }
+            CHECK( differs );
+        }
+
+        SECTION( "Classes" ) {
+            std::vector< int > count( 4, 0 );
+            double values[3];
+            for( std::uint64_t i = 0; i < 1000; i++ ) {
+                unsigned c = generator.generate( i, values );
+                REQUIRE( c < 4 );
+                count[c]++;
+            }
+            for( int c : count )
+                CHECK( c > 0 );
+        }
+    }
+
+    SECTION( "Parameters" ) {
+        CHECK_THROWS( SyntheticDataset( SyntheticDataset::gaussian, 0, 2, 0, 1 ) );
+        CHECK_THROWS( SyntheticDataset( SyntheticDataset::gaussian, 2, 0, 0, 1 ) );
+        CHECK_THROWS( SyntheticDataset( SyntheticDataset::gaussian, 2, 2, 1.5, 1 ) );
+        CHECK_THROWS( SyntheticDataset( SyntheticDataset::spiral, 1, 2, 0, 1 ) );
+    }
+}
+
+TEST_CASE( "Binary datasets", "[synthetic]" ) {
+    DataSet dataset = SyntheticDataset( SyntheticDataset::gaussian, 2, 3, 0, 7 ).dataset( 50 );
+
+    std::FILE * file = std::tmpfile();
+    write_binary_dataset( file, dataset );
+    std::rewind( file );
+    DataSet read = read_binary_dataset( file );
+    std::fclose( file );
+
+    REQUIRE( read.size() == 50 );
+    REQUIRE( read.attribute_count() == 2 );
+    REQUIRE( read.category_count() == 1 );
+    CHECK( read.attribute_name( 1 ) == "x1" );
+    CHECK( read.category_name( 0 ) == "class" );
+    auto it = read.begin();
+    for( const DataEntry & entry : dataset ) {
+        CHECK( it->attribute( 0 ) == entry.attribute( 0 ) );
+        CHECK( it->attribute( 1 ) == entry.attribute( 1 ) );
+        CHECK( it->category( 0 ) == entry.category( 0 ) );
+        ++it;
+    }
+
+    file = std::tmpfile();
+    std::fputs( "PRDB", file );
+    std::rewind( file );
+    CHECK_THROWS( read_binary_dataset( file ) );
+    std::fclose( file );
+}
@@ -1,4 +1,9 @@
 #include "util/csv.h"
+#include "util/interval.h"
+#include "util/parallel.hpp"
+#include "util/stats.h"
+#include <cstring>
+#include <thread>
 #include <catch.hpp>
 
 TEST_CASE( "Comma-separated value parsing", "[csv][parse][util]" ) {
@@ -89,3 +94,108 @@ TEST_CASE( "Comma-separated value parsing", "[csv][parse][util]" ) {
         CHECK( std::fgetc(file) == EOF );
     }
 }
+
+TEST_CASE( "Memoized precision intervals", "[interval][util]" ) {
+    interval_table table( 1.28 );
+    CHECK( table.threshold() == 1.28 );
+    for( int n : {1, 2, 10, 63, 64, 65, 1000} )
+        for( int k : {0, 1, n/3, n-1, n} ) {
+            interval expected = precision_interval( (double) k / n, n, 1.28 );
+            interval first = table( k, n );
+            interval second = table( k, n );
+            CHECK( first.min == expected.min );
+            CHECK( first.max == expected.max );
+            CHECK( second.min == expected.min );
+            CHECK( second.max == expected.max );
+        }
+}
+
+TEST_CASE( "Bounded queue pipeline", "[parallel][util]" ) {
+    util::bounded_queue< int > first( 2 ), second( 3 );
+
+    std::thread producer( [&]() {
+        for( int i = 0; i < 1000; i++ )
+            first.push( i );
+        first.close();
+    });
+    std::thread stage( [&]() {
+        int i;
+        while( first.pop( i ) )
+            second.push( 2 * i );
+        second.close();
+    });
+
+    std::vector< int > received;
+    int i;
+    while( second.pop( i ) )
+        received.push_back( i );
+    producer.join();
+    stage.join();
+
+    REQUIRE( received.size() == 1000 );
+    for( int j = 0; j < 1000; j++ )
+        CHECK( received[j] == 2 * j );
+}
+
+TEST_CASE( "Closing a bounded queue releases the producers", "[parallel][util]" ) {
+    util::bounded_queue< int > queue( 1 );
+    bool accepted = true;
+    std::thread producer( [&]() {
+        queue.push( 1 );
+        // The queue is full and nobody pops, so this waits for close().
+        accepted = queue.push( 2 );
+    });
+    queue.close();
+    producer.join();
+    CHECK_FALSE( accepted );
+    CHECK_FALSE( queue.push( 3 ) );
+}
+
+TEST_CASE( "Statistics", "[stats][util]" ) {
+    util::stats::counter counter( "test.counter" );
+    util::stats::phase phase( "test.phase" );
+    util::stats::series series( "test.series" );
+
+    SECTION( "Disabled" ) {
+        counter.add( 5 );
+        { util::stats::timer timer( phase ); }
+        series.record( 1, 2.0 );
+        CHECK( counter.value() == 0 );
+        CHECK( phase.runs() == 0 );
+        CHECK( series.samples().empty() );
+    }
+
+    SECTION( "Enabled" ) {
+        util::stats::enabled() = true;
+        util::parallel_for( 0, 1000, [&]( std::size_t ) {
+            counter.add();
+        });
+        counter.add( 24 );
+        {
+            util::stats::timer timer( phase );
+            util::stats::timer stopped( phase );
+            stopped.stop();
+        }
+        series.record( 10, 3.0 );
+        series.record( 20, 4.5 );
+        util::stats::enabled() = false;
+
+        CHECK( counter.value() == 1024 );
+        CHECK( phase.runs() == 2 );
+        CHECK( phase.seconds() >= 0 );
+        REQUIRE( series.samples().size() == 2 );
+        CHECK( series.samples()[1].first == 20 );
+        CHECK( series.samples()[1].second == 4.5 );
+
+        char * text;
+        std::size_t length;
+        std::FILE * file = open_memstream( &text, &length );
+        util::stats::report( file );
+        std::fclose( file );
+        CHECK( std::strstr( text, "test.counter" ) != nullptr );
+        CHECK( std::strstr( text, "1024" ) != nullptr );
+        CHECK( std::strstr( text, "test.phase" ) != nullptr );
+        CHECK( std::strstr( text, "test.series: 10:3 20:4.5" ) != nullptr );
+        std::free( text );
+    }
+}
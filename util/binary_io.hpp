@@ -0,0 +1,100 @@
+#ifndef UTIL_BINARY_IO_HPP
+#define UTIL_BINARY_IO_HPP
+
+/* Reading and writing of the binary file formats,
+ * like those of pr/binary_dataset.h and pr/decision_map.h.
+ *
+ * The values are stored with their native size and byte order.
+ * Each file starts with a signature:
+ * four magic bytes followed by a std::uint32_t version.
+ *
+ * Every function receives the messages it throws on failure,
+ * so that each format reports its own errors;
+ * they must be string literals, like the other exceptions of this project.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace util {
+
+    /* Writes/reads `count` values of type T to/from the given array.
+     */
+    template< typename T >
+    void put_array( std::FILE * file, const T * values, std::size_t count, const char * error ) {
+        if( std::fwrite( values, sizeof(T), count, file ) != count )
+            throw error;
+    }
+
+    template< typename T >
+    void get_array( std::FILE * file, T * values, std::size_t count, const char * truncated ) {
+        if( std::fread( values, sizeof(T), count, file ) != count )
+            throw truncated;
+    }
+
+    /* Writes/reads a single value of type T.
+     */
+    template< typename T >
+    void put( std::FILE * file, const T & value, const char * error ) {
+        put_array( file, &value, 1, error );
+    }
+
+    template< typename T >
+    T get( std::FILE * file, const char * truncated ) {
+        T value;
+        get_array( file, &value, 1, truncated );
+        return value;
+    }
+
+    /* Strings are stored as their std::uint32_t length
+     * followed by their characters.
+     */
+    inline void put_string( std::FILE * file, const std::string & str, const char * error ) {
+        put< std::uint32_t >( file, str.size(), error );
+        put_array( file, str.data(), str.size(), error );
+    }
+
+    inline std::string get_string( std::FILE * file, const char * truncated ) {
+        std::string str( get< std::uint32_t >( file, truncated ), '\0' );
+        get_array( file, &str[0], str.size(), truncated );
+        return str;
+    }
+
+    /* Writes the signature of a format.
+     */
+    inline void put_signature(
+        std::FILE * file,
+        const char (& magic)[4],
+        std::uint32_t version,
+        const char * error
+    ) {
+        put_array( file, magic, 4, error );
+        put( file, version, error );
+    }
+
+    /* Reads the signature of a file, and throws
+     * `wrong_format` if the magic bytes are missing or differ from `magic`,
+     * `truncated` if the version is missing,
+     * or `wrong_version` if the version differs from `version`.
+     */
+    inline void check_signature(
+        std::FILE * file,
+        const char (& magic)[4],
+        std::uint32_t version,
+        const char * wrong_format,
+        const char * wrong_version,
+        const char * truncated
+    ) {
+        char start[4];
+        if( std::fread( start, 1, 4, file ) != 4 || std::memcmp( start, magic, 4 ) != 0 )
+            throw wrong_format;
+        if( get< std::uint32_t >( file, truncated ) != version )
+            throw wrong_version;
+    }
+
+} // namespace util
+
+#endif // UTIL_BINARY_IO_HPP
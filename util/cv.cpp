@@ -1,13 +1,29 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 #include "cv.h"
+#include "pr/decision_map.h"
 #include "pr/dendogram_node.h"
 #include "pr/grid_generator.h"
+#include "pr/nearest_neighbor.h"
+#include "util/parallel.hpp"
+#include "util/stats.h"
 
 #include <stdio.h>
 
 namespace util {
 
+namespace {
+    stats::counter mapped_pixels( "map_colors.pixels" );
+    stats::counter mapped_colors( "map_colors.distinct_colors" );
+} // anonymous namespace
+
 DataEntry entryFromVec( const cv::Vec3b & vec ) {
     /* Conversions from integer types to floating point types are "narrowing",
      * so the compiler is required to issue an error
@@ -57,6 +73,142 @@ cv::Scalar category_color( std::string category ) {
     return color_list[pair.first->second];
 };
 
+void map_colors(
+    cv::Mat & img,
+    const std::function< cv::Vec3b( const cv::Vec3b & ) > & f
+) {
+    auto key = []( const cv::Vec3b & color ) {
+        return std::uint32_t( color[0] ) |
+            std::uint32_t( color[1] ) << 8 |
+            std::uint32_t( color[2] ) << 16;
+    };
+    const std::size_t rows_per_block = 16;
+
+    /* First, gather the distinct colors.
+     * Each block of rows collects its colors locally,
+     * and only then merges them into the global set.
+     */
+    std::unordered_set< std::uint32_t > distinct;
+    std::mutex distinct_mutex;
+    util::parallel_blocks( 0, img.rows, rows_per_block, [&]( std::size_t begin, std::size_t end ) {
+        std::unordered_set< std::uint32_t > local;
+        for( std::size_t y = begin; y < end; y++ ) {
+            const cv::Vec3b * row = img.ptr<cv::Vec3b>( y );
+            for( int x = 0; x < img.cols; x++ )
+                local.insert( key(row[x]) );
+        }
+        std::lock_guard< std::mutex > lock( distinct_mutex );
+        distinct.insert( local.begin(), local.end() );
+    });
+
+    mapped_pixels.add( (std::size_t) img.rows * img.cols );
+    mapped_colors.add( distinct.size() );
+
+    // Then, compute the new color of each distinct color.
+    std::vector< std::uint32_t > colors( distinct.begin(), distinct.end() );
+    std::vector< cv::Vec3b > results( colors.size() );
+    util::parallel_for( 0, colors.size(), [&]( std::size_t i ) {
+        cv::Vec3b color( colors[i] & 0xff, (colors[i] >> 8) & 0xff, colors[i] >> 16 );
+        results[i] = f( color );
+    });
+    std::unordered_map< std::uint32_t, cv::Vec3b > table;
+    table.reserve( colors.size() );
+    for( std::size_t i = 0; i < colors.size(); i++ )
+        table.emplace( colors[i], results[i] );
+
+    /* Finally, rewrite the image.
+     * Neighbor pixels often have the same color,
+     * so the last lookup is remembered.
+     */
+    util::parallel_blocks( 0, img.rows, rows_per_block, [&]( std::size_t begin, std::size_t end ) {
+        for( std::size_t y = begin; y < end; y++ ) {
+            cv::Vec3b * row = img.ptr<cv::Vec3b>( y );
+            std::uint32_t last_key = -1;
+            cv::Vec3b last_value;
+            for( int x = 0; x < img.cols; x++ ) {
+                std::uint32_t k = key( row[x] );
+                if( k != last_key ) {
+                    last_key = k;
+                    last_value = table.at( k );
+                }
+                row[x] = last_value;
+            }
+        }
+    });
+}
+
+void similarity_map( cv::Mat & img, const LinearColorDistance & distance ) {
+    if( distance.p != 1 && distance.p != 2 )
+        throw std::out_of_range( "The color distance needs p = 1 or p = 2." );
+    const bool manhattan = distance.p == 1;
+
+    const float m0 = distance.origin[0];
+    const float m1 = distance.origin[1];
+    const float m2 = distance.origin[2];
+    const float w00 = distance.transform[0][0];
+    const float w01 = distance.transform[0][1];
+    const float w02 = distance.transform[0][2];
+    const float w10 = distance.transform[1][0];
+    const float w11 = distance.transform[1][1];
+    const float w12 = distance.transform[1][2];
+    const float w20 = distance.transform[2][0];
+    const float w21 = distance.transform[2][1];
+    const float w22 = distance.transform[2][2];
+
+    /* Every loop below must stay free of branches to be vectorized;
+     * see the flags of util/cv.o in the makefile.
+     */
+    util::parallel_blocks( 0, img.rows, 16, [=, &img]( std::size_t begin, std::size_t end ) {
+        const int cols = img.cols;
+        std::vector< float > lanes( 4 * cols );
+        float * c0 = lanes.data();
+        float * c1 = c0 + cols;
+        float * c2 = c1 + cols;
+        float * d = c2 + cols;
+        std::vector< unsigned char > grays( cols );
+        unsigned char * gray = grays.data();
+
+        for( std::size_t y = begin; y < end; y++ ) {
+            /* The channels are read and written one at a time;
+             * a loop over the three interleaved bytes at once
+             * is not vectorized without byte shuffles (SSSE3).
+             */
+            unsigned char * row = img.ptr<unsigned char>( y );
+            for( int x = 0; x < cols; x++ )
+                c0[x] = row[3*x] - m0;
+            for( int x = 0; x < cols; x++ )
+                c1[x] = row[3*x + 1] - m1;
+            for( int x = 0; x < cols; x++ )
+                c2[x] = row[3*x + 2] - m2;
+
+            if( manhattan )
+                for( int x = 0; x < cols; x++ )
+                    d[x] = std::fabs( w00 * c0[x] + w01 * c1[x] + w02 * c2[x] )
+                         + std::fabs( w10 * c0[x] + w11 * c1[x] + w12 * c2[x] )
+                         + std::fabs( w20 * c0[x] + w21 * c1[x] + w22 * c2[x] );
+            else
+                for( int x = 0; x < cols; x++ ) {
+                    float v0 = w00 * c0[x] + w01 * c1[x] + w02 * c2[x];
+                    float v1 = w10 * c0[x] + w11 * c1[x] + w12 * c2[x];
+                    float v2 = w20 * c0[x] + w21 * c1[x] + w22 * c2[x];
+                    d[x] = std::sqrt( v0 * v0 + v1 * v1 + v2 * v2 );
+                }
+
+            // NaNs fail the comparison, so they become black.
+            for( int x = 0; x < cols; x++ ) {
+                float level = d[x] <= 1 ? 255 * (1 - d[x]) : 0;
+                gray[x] = level;
+            }
+            for( int x = 0; x < cols; x++ )
+                row[3*x] = gray[x];
+            for( int x = 0; x < cols; x++ )
+                row[3*x + 1] = gray[x];
+            for( int x = 0; x < cols; x++ )
+                row[3*x + 2] = gray[x];
+        }
+    });
+}
+
 void show_dataset(
     cv::Mat & output,
     const DataSet & input,
@@ -87,7 +239,12 @@ void show_dataset(
     }
 }
 
-void influence_areas( cv::Mat & img, const NearestNeighbor & nn, double border ) {
+void influence_areas(
+    cv::Mat & img,
+    const NearestNeighbor & nn,
+    double border,
+    bool brute_force
+) {
     if( nn.dataset().attribute_count() != 2 )
         throw std::out_of_range(
             "The input dataset must have exactly two attributes."
@@ -102,14 +259,33 @@ void influence_areas( cv::Mat & img, const NearestNeighbor & nn, double border )
     grid.density( std::vector<unsigned>{(unsigned) img.cols, (unsigned) img.rows} );
     grid.calibrate( nn.dataset() );
 
-    for( int i = 0; i < img.rows; i++ )
-        for( int j = 0; j < img.cols; j++ ) {
-            DataEntry data = grid( {(unsigned)i, (unsigned)j} );
-            std::string category = *nn.classify(data).begin();
-            auto color = util::category_color(category);
-            img.at<cv::Vec3b>(img.rows - j - 1, i) =
-                cv::Vec3b( color[0], color[1], color[2] );
+    /* The grid is affine in each coordinate,
+     * so the coordinates of every column and row are computed once.
+     * The pixel (x, y) of the grid is at the row img.rows - y - 1.
+     */
+    std::vector< double > xs( img.cols ), ys( img.rows );
+    for( int x = 0; x < img.cols; x++ )
+        xs[x] = grid.coordinate( 0, x );
+    for( int y = 0; y < img.rows; y++ )
+        ys[y] = grid.coordinate( 1, y );
+
+    /* The labels index the categories in the order of the dataset,
+     * which is also the order the colors are assigned by show_dataset.
+     */
+    std::vector< cv::Vec3b > colors;
+    std::set< std::string > seen;
+    for( const DataEntry & entry : nn.dataset() )
+        if( seen.insert( entry.category(0) ).second ) {
+            auto color = category_color( entry.category(0) );
+            colors.push_back( cv::Vec3b( color[0], color[1], color[2] ) );
         }
+
+    std::vector< std::uint16_t > labels = classify_plane( nn, xs, ys, brute_force );
+    for( int y = 0; y < img.rows; y++ ) {
+        cv::Vec3b * row = img.ptr<cv::Vec3b>( img.rows - y - 1 );
+        for( int x = 0; x < img.cols; x++ )
+            row[x] = colors[labels[(std::size_t) y * img.cols + x]];
+    }
 }
 
 int print_dendogram( cv::Mat & output, const DendogramNode & input ) {
@@ -128,6 +304,12 @@ int print_dendogram( cv::Mat & output, const DendogramNode & input ) {
     // This guarantees each image will be at least one pixel wide.
     upper_limit = std::max( upper_limit, 1 );
     lower_limit = std::max( lower_limit, 1 );
+    /* Non-monotone linkages may give a child
+     * a linkage distance greater than its parent's;
+     * such children are drawn at the position of the parent.
+     */
+    upper_limit = std::min( upper_limit, width );
+    lower_limit = std::min( lower_limit, width );
 
     cv::Mat upper_img = output( cv::Range(0, middle), cv::Range(0, upper_limit) );
     cv::Mat lower_img = output( cv::Range(middle, height), cv::Range(0, lower_limit) );
@@ -5,6 +5,7 @@
  * and our internal representation.
  */
 
+#include <functional>
 #include <opencv2/core/core.hpp>
 #include "pr/classifier.h"
 #include "pr/data_entry.h"
@@ -29,6 +30,52 @@ namespace util {
      */
     cv::Scalar category_color( std::string category );
 
+    /* Replaces each pixel of the image, which must be CV_8UC3,
+     * by the color returned by f for the color of that pixel.
+     *
+     * f is called only once for each distinct color in the image,
+     * so the calls to f scale with the number of distinct colors,
+     * not with the number of pixels; the scan itself is per pixel.
+     * The image is scanned and rewritten in parallel, by rows,
+     * and f is also called concurrently;
+     * see util/parallel.hpp to choose the number of threads.
+     */
+    void map_colors(
+        cv::Mat & img,
+        const std::function< cv::Vec3b( const cv::Vec3b & ) > & f
+    );
+
+    /* Distance between colors of the form |W (x - m)|_p,
+     * for a 3x3 matrix W (the transform) and p = 1 or p = 2.
+     *
+     * The Mahalanobis distance is such a distance, with p = 2
+     * and W = MahalanobisDistance::whitening();
+     * so are EuclideanDistance (p = 2) and ManhattanDistance (p = 1),
+     * with W diagonal, given by NormalizingDistanceCalculator::scale().
+     */
+    struct LinearColorDistance {
+        double origin[3];
+        double transform[3][3];
+        double p;
+    };
+
+    /* Replaces each pixel x of the image, which must be CV_8UC3,
+     * by the gray level 255 * (1 - d(x)), where d(x) = |W (x - m)|_p,
+     * or by black if d(x) > 1.
+     *
+     * Unlike map_colors, every pixel is computed, in a single pass.
+     * Each row is spread into one float array per channel,
+     * so that, when compiled with -O3, the loops over the pixels
+     * are vectorized; the makefile compiles util/cv.cpp
+     * with -fno-math-errno and -fno-trapping-math for that.
+     * The rows are processed in parallel; see util/parallel.hpp.
+     *
+     * The arithmetic is in single precision, so some gray levels
+     * may be off by one from those computed with a DistanceCalculator.
+     * Throws if p is neither 1 nor 2.
+     */
+    void similarity_map( cv::Mat & img, const LinearColorDistance & distance );
+
     /* List of colors avaliable through util::category_color.
      */
     extern const std::vector< cv::Scalar > color_list;
@@ -54,11 +101,15 @@ namespace util {
      *
      * border is the percentage of the data set extremum points
      * that will be used to create a border.
+     *
+     * The pixels are classified by classify_plane (pr/decision_map.h),
+     * which is where brute_force is explained.
      */
     void influence_areas(
         cv::Mat & output,
         const NearestNeighbor & input,
-        double border
+        double border,
+        bool brute_force = false
     );
 
     /* Draws the dendogram in the image.
@@ -17,3 +17,32 @@ interval frequency_interval( double p, int n, double z ) {
      */
     return precision_interval(p, n, z);
 }
+
+constexpr int interval_table::dense_limit;
+
+interval_table::interval_table( double z ) :
+    z( z )
+{
+    dense.reserve( dense_limit * (dense_limit + 1) / 2 );
+    dense.push_back( interval{0, 0} ); // n = 0 is meaningless.
+    for( int n = 1; n < dense_limit; n++ )
+        for( int k = 0; k <= n; k++ )
+            dense.push_back( precision_interval( (double) k / n, n, z ) );
+}
+
+interval interval_table::operator()( int k, int n ) {
+    if( n < dense_limit )
+        return dense[n * (n+1) / 2 + k];
+
+    unsigned long long key = (unsigned long long) n << 32 | (unsigned) k;
+    auto it = sparse.find( key );
+    if( it != sparse.end() )
+        return it->second;
+    interval result = precision_interval( (double) k / n, n, z );
+    sparse.emplace( key, result );
+    return result;
+}
+
+double interval_table::threshold() const {
+    return z;
+}
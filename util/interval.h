@@ -1,6 +1,9 @@
 #ifndef UTIL_INTERVAL_H
 #define UTIL_INTERVAL_H
 
+#include <unordered_map>
+#include <vector>
+
 /* Class that represents an interval.
  * Mainly used in the IBL3 algorithm.
  */
@@ -44,4 +47,32 @@ interval precision_interval( double p, int n, double z );
  */
 interval frequency_interval( double p, int n, double z );
 
+/* Memoized precision_interval for a fixed acceptance threshold.
+ *
+ * The arguments are the counts themselves:
+ * table(k, n) is precision_interval( (double) k / n, n, z ),
+ * bit-for-bit, for 0 <= k <= n and n > 0.
+ *
+ * In the IBL3 algorithm, each instance is used only a handful of times,
+ * so the pairs (k, n) repeat a lot between the instances.
+ * The intervals for small n are precomputed on construction;
+ * the others are computed on demand and remembered.
+ */
+class interval_table {
+    double z;
+
+    // Intervals for n < dense_limit; the pair (k, n) is at n*(n+1)/2 + k.
+    static constexpr int dense_limit = 64;
+    std::vector< interval > dense;
+
+    std::unordered_map< unsigned long long, interval > sparse;
+
+public:
+    explicit interval_table( double z );
+
+    interval operator()( int k, int n );
+
+    double threshold() const;
+};
+
 #endif // UTIL_INTERVAL_H
@@ -0,0 +1,167 @@
+#ifndef UTIL_PARALLEL_HPP
+#define UTIL_PARALLEL_HPP
+
+/* Minimal thread-based parallel loops.
+ *
+ * The work is split in blocks that are handed to the threads on demand,
+ * so uneven blocks (like nearest neighbor queries in a kd-tree)
+ * are still balanced between the threads.
+ * Which thread processes which block is not deterministic,
+ * so the callers must write the results of each index
+ * in a position reserved to that index
+ * if they want deterministic output.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+    /* Number of threads used by the functions below.
+     * Defaults to the number of hardware threads;
+     * assign 1 to it to run everything in the calling thread.
+     */
+    inline unsigned & thread_count() {
+        static unsigned count = std::max( 1u, std::thread::hardware_concurrency() );
+        return count;
+    }
+
+    /* Calls f(block_begin, block_end) for consecutive blocks of at most
+     * `grain` elements that cover the interval [begin, end).
+     * The calls happen concurrently, in up to thread_count() threads.
+     *
+     * If some call throws, the remaining blocks are skipped
+     * and the first exception is rethrown in the calling thread.
+     */
+    template< typename Function >
+    void parallel_blocks(
+        std::size_t begin,
+        std::size_t end,
+        std::size_t grain,
+        Function f
+    ) {
+        if( begin >= end )
+            return;
+        grain = std::max<std::size_t>( grain, 1 );
+        std::size_t blocks = (end - begin + grain - 1) / grain;
+        unsigned threads = std::min<std::size_t>( thread_count(), blocks );
+
+        if( threads <= 1 ) {
+            for( std::size_t b = begin; b < end; b += grain )
+                f( b, std::min(b + grain, end) );
+            return;
+        }
+
+        std::atomic< std::size_t > next_block( 0 );
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto worker = [&]() {
+            while( true ) {
+                std::size_t block = next_block++;
+                if( block >= blocks )
+                    return;
+                std::size_t b = begin + block * grain;
+                try {
+                    f( b, std::min(b + grain, end) );
+                }
+                catch( ... ) {
+                    std::lock_guard< std::mutex > lock( error_mutex );
+                    if( !error )
+                        error = std::current_exception();
+                    next_block = blocks;
+                }
+            }
+        };
+
+        std::vector< std::thread > pool;
+        for( unsigned i = 1; i < threads; i++ )
+            pool.emplace_back( worker );
+        worker();
+        for( auto & thread : pool )
+            thread.join();
+
+        if( error )
+            std::rethrow_exception( error );
+    }
+
+    /* Calls f(i) for every i in [begin, end), concurrently.
+     */
+    template< typename Function >
+    void parallel_for( std::size_t begin, std::size_t end, Function f ) {
+        std::size_t size = end > begin ? end - begin : 0;
+        std::size_t grain = std::max<std::size_t>( 1, size / (16 * thread_count()) );
+        parallel_blocks( begin, end, grain, [&f]( std::size_t b, std::size_t e ) {
+            for( std::size_t i = b; i < e; i++ )
+                f( i );
+        });
+    }
+
+    /* Queue of bounded capacity, for pipelines of threads:
+     * each stage pops from the queue of the previous stage
+     * and pushes to the queue of the next one.
+     * The bound keeps a fast stage from running too far ahead of a slow one.
+     *
+     * The producer calls close() when it is done;
+     * then pop() returns false once the queue is drained.
+     * Closing also releases producers blocked in push(),
+     * so a consumer may close the queue to abort the pipeline.
+     */
+    template< typename T >
+    class bounded_queue {
+        std::deque< T > items;
+        std::size_t capacity;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+
+    public:
+        explicit bounded_queue( std::size_t capacity ) :
+            capacity( std::max<std::size_t>( capacity, 1 ) )
+        {}
+
+        /* Blocks while the queue is full.
+         * Returns false, discarding the item, if the queue is closed.
+         */
+        bool push( T item ) {
+            std::unique_lock< std::mutex > lock( mutex );
+            not_full.wait( lock, [this]{ return closed || items.size() < capacity; } );
+            if( closed )
+                return false;
+            items.push_back( std::move(item) );
+            not_empty.notify_one();
+            return true;
+        }
+
+        /* Blocks while the queue is empty but still open.
+         * Returns false if the queue is closed and empty.
+         */
+        bool pop( T & item ) {
+            std::unique_lock< std::mutex > lock( mutex );
+            not_empty.wait( lock, [this]{ return closed || !items.empty(); } );
+            if( items.empty() )
+                return false;
+            item = std::move( items.front() );
+            items.pop_front();
+            not_full.notify_one();
+            return true;
+        }
+
+        void close() {
+            std::lock_guard< std::mutex > lock( mutex );
+            closed = true;
+            not_empty.notify_all();
+            not_full.notify_all();
+        }
+    };
+
+} // namespace util
+
+#endif // UTIL_PARALLEL_HPP
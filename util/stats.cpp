@@ -0,0 +1,179 @@
+/* Implementation of stats.h.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "stats.h"
+
+namespace util {
+namespace stats {
+
+namespace {
+    /* Every statistic registers itself on construction
+     * and unregisters on destruction.
+     * The registry itself is never destroyed,
+     * so the statistics with static storage duration
+     * may unregister in any order at the program termination.
+     */
+    struct registry {
+        std::mutex mutex;
+        std::vector< const counter * > counters;
+        std::vector< const phase * > phases;
+        std::vector< const series * > series_list;
+    };
+
+    registry & global_registry() {
+        static registry * r = new registry;
+        return *r;
+    }
+
+    std::size_t name_width() {
+        registry & r = global_registry();
+        std::size_t width = 8;
+        for( const counter * c : r.counters )
+            width = std::max( width, std::strlen( c->name() ) );
+        for( const phase * p : r.phases )
+            width = std::max( width, std::strlen( p->name() ) );
+        return width;
+    }
+
+    template< typename T >
+    void unregister( std::vector< const T * > & list, const T * item ) {
+        registry & r = global_registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        list.erase( std::remove( list.begin(), list.end(), item ), list.end() );
+    }
+
+    void report_stderr() {
+        report( stderr );
+    }
+} // anonymous namespace
+
+void enable() {
+    if( enabled() )
+        return;
+    enabled() = true;
+    std::atexit( report_stderr );
+}
+
+void report( std::FILE * file ) {
+    registry & r = global_registry();
+    std::lock_guard< std::mutex > lock( r.mutex );
+    int width = name_width();
+
+    bool header = false;
+    for( const phase * p : r.phases ) {
+        if( p->runs() == 0 )
+            continue;
+        if( !header ) {
+            std::fprintf( file, "%-*s %12s %8s\n", width, "phase", "seconds", "runs" );
+            header = true;
+        }
+        std::fprintf( file, "%-*s %12.6f %8llu\n",
+            width, p->name(), p->seconds(), (unsigned long long) p->runs() );
+    }
+
+    header = false;
+    for( const counter * c : r.counters ) {
+        if( c->value() == 0 )
+            continue;
+        if( !header ) {
+            std::fprintf( file, "%-*s %12s\n", width, "counter", "value" );
+            header = true;
+        }
+        std::fprintf( file, "%-*s %12llu\n",
+            width, c->name(), (unsigned long long) c->value() );
+    }
+
+    for( const series * s : r.series_list ) {
+        auto samples = s->samples();
+        if( samples.empty() )
+            continue;
+        std::fprintf( file, "%s:", s->name() );
+        for( const auto & sample : samples )
+            std::fprintf( file, " %llu:%g", (unsigned long long) sample.first, sample.second );
+        std::fprintf( file, "\n" );
+    }
+}
+
+counter::counter( const char * name ) :
+    _name( name ),
+    _value( 0 )
+{
+    registry & r = global_registry();
+    std::lock_guard< std::mutex > lock( r.mutex );
+    r.counters.push_back( this );
+}
+
+counter::~counter() {
+    unregister( global_registry().counters, this );
+}
+
+const char * counter::name() const {
+    return _name;
+}
+
+std::uint64_t counter::value() const {
+    return _value.load( std::memory_order_relaxed );
+}
+
+phase::phase( const char * name ) :
+    _name( name ),
+    _nanoseconds( 0 ),
+    _runs( 0 )
+{
+    registry & r = global_registry();
+    std::lock_guard< std::mutex > lock( r.mutex );
+    r.phases.push_back( this );
+}
+
+void phase::add( std::chrono::steady_clock::duration elapsed ) {
+    auto ns = std::chrono::duration_cast< std::chrono::nanoseconds >( elapsed ).count();
+    _nanoseconds.fetch_add( ns, std::memory_order_relaxed );
+    _runs.fetch_add( 1, std::memory_order_relaxed );
+}
+
+phase::~phase() {
+    unregister( global_registry().phases, this );
+}
+
+const char * phase::name() const {
+    return _name;
+}
+
+double phase::seconds() const {
+    return _nanoseconds.load( std::memory_order_relaxed ) * 1e-9;
+}
+
+std::uint64_t phase::runs() const {
+    return _runs.load( std::memory_order_relaxed );
+}
+
+series::series( const char * name ) :
+    _name( name )
+{
+    registry & r = global_registry();
+    std::lock_guard< std::mutex > lock( r.mutex );
+    r.series_list.push_back( this );
+}
+
+void series::push( std::uint64_t x, double y ) {
+    std::lock_guard< std::mutex > lock( mutex );
+    _samples.emplace_back( x, y );
+}
+
+series::~series() {
+    unregister( global_registry().series_list, this );
+}
+
+const char * series::name() const {
+    return _name;
+}
+
+std::vector< std::pair< std::uint64_t, double > > series::samples() const {
+    std::lock_guard< std::mutex > lock( mutex );
+    return _samples;
+}
+
+} // namespace stats
+} // namespace util
@@ -0,0 +1,140 @@
+#ifndef UTIL_STATS_H
+#define UTIL_STATS_H
+
+/* Lightweight instrumentation: counters, phase timers and series,
+ * reported by the drivers with the option --stats.
+ *
+ * Each statistic is an object, usually with static storage duration,
+ * defined in the file that updates it and named "module.what";
+ * it is listed in the report while it exists.
+ * While the collection is disabled (the default),
+ * updating a statistic costs a single test of a global flag;
+ * so the updates should be placed outside of the innermost loops,
+ * adding up a whole loop at once where possible.
+ *
+ * Counters and timers may be updated concurrently.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace util {
+namespace stats {
+
+    // Whether the statistics are being collected.
+    inline bool & enabled() {
+        static bool flag = false;
+        return flag;
+    }
+
+    /* Starts collecting the statistics,
+     * and arranges for report(stderr) to be called at exit.
+     */
+    void enable();
+
+    /* Writes every statistic that was updated at least once,
+     * grouped by kind and in order of definition.
+     */
+    void report( std::FILE * );
+
+    class counter {
+        const char * _name;
+        std::atomic< std::uint64_t > _value;
+    public:
+        explicit counter( const char * name );
+        ~counter();
+        counter( const counter & ) = delete;
+        counter & operator=( const counter & ) = delete;
+
+        void add( std::uint64_t amount = 1 ) {
+            if( enabled() )
+                _value.fetch_add( amount, std::memory_order_relaxed );
+        }
+
+        const char * name() const;
+        std::uint64_t value() const;
+    };
+
+    /* Accumulated wall-clock time and number of runs of some phase.
+     * Timed with the scoped `timer` below.
+     */
+    class phase {
+        const char * _name;
+        std::atomic< std::uint64_t > _nanoseconds;
+        std::atomic< std::uint64_t > _runs;
+    public:
+        explicit phase( const char * name );
+        ~phase();
+        phase( const phase & ) = delete;
+        phase & operator=( const phase & ) = delete;
+
+        void add( std::chrono::steady_clock::duration );
+
+        const char * name() const;
+        double seconds() const;
+        std::uint64_t runs() const;
+    };
+
+    /* Times the phase from construction to destruction,
+     * or to the call to stop().
+     * The clock is not read while the collection is disabled.
+     */
+    class timer {
+        phase & _phase;
+        bool running;
+        std::chrono::steady_clock::time_point start;
+    public:
+        explicit timer( phase & p ) :
+            _phase( p ),
+            running( enabled() )
+        {
+            if( running )
+                start = std::chrono::steady_clock::now();
+        }
+        timer( const timer & ) = delete;
+        timer & operator=( const timer & ) = delete;
+
+        ~timer() {
+            stop();
+        }
+
+        void stop() {
+            if( running )
+                _phase.add( std::chrono::steady_clock::now() - start );
+            running = false;
+        }
+    };
+
+    /* Sequence of (x, y) samples, like the size of some structure
+     * (y) after each number of steps (x) of an algorithm.
+     * Samples recorded concurrently are kept in arrival order.
+     */
+    class series {
+        const char * _name;
+        mutable std::mutex mutex;
+        std::vector< std::pair< std::uint64_t, double > > _samples;
+    public:
+        explicit series( const char * name );
+        ~series();
+        series( const series & ) = delete;
+        series & operator=( const series & ) = delete;
+
+        void record( std::uint64_t x, double y ) {
+            if( enabled() )
+                push( x, y );
+        }
+        void push( std::uint64_t x, double y );
+
+        const char * name() const;
+        std::vector< std::pair< std::uint64_t, double > > samples() const;
+    };
+
+} // namespace stats
+} // namespace util
+
+#endif // UTIL_STATS_H